@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+
+import argparse
+import struct
+import subprocess
+
+SKIPPABLE_FRAME_MAGIC = 0x184D2A5E
+SEEK_TABLE_MAGIC = 0x8F92EAB1
+DEFAULT_FRAME_SIZE = 4 * 1024 * 1024
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description="Compresses a file in the seekable zstd format, which "
+        + "Loimos can read without decompressing the whole file"
+    )
+
+    # Positional/required arguments:
+    parser.add_argument(
+        "in_path",
+        metavar="I",
+        help="The file to compress (e.g. visits.csv)",
+    )
+
+    # Named/optional arguments:
+    parser.add_argument(
+        "-o",
+        "--out-path",
+        help="Where to write the compressed file (defaults to the input path "
+        + "with .zst appended)",
+    )
+    parser.add_argument(
+        "-f",
+        "--frame-size",
+        type=int,
+        default=DEFAULT_FRAME_SIZE,
+        help="How many bytes of input to compress into each independent frame",
+    )
+    parser.add_argument(
+        "-l",
+        "--level",
+        type=int,
+        default=3,
+        help="The zstd compression level to use",
+    )
+
+    return parser.parse_args()
+
+
+def compress_frame(data, level):
+    return subprocess.run(
+        ["zstd", "-q", "-c", f"-{level}"],
+        input=data,
+        stdout=subprocess.PIPE,
+        check=True,
+    ).stdout
+
+
+def main():
+    args = parse_args()
+    out_path = args.out_path or args.in_path + ".zst"
+
+    # Each frame is compressed on its own, so any one can be decompressed
+    # without the others
+    entries = []
+    with open(args.in_path, "rb") as in_file, open(out_path, "wb") as out_file:
+        while True:
+            data = in_file.read(args.frame_size)
+            if not data:
+                break
+            frame = compress_frame(data, args.level)
+            out_file.write(frame)
+            entries.append((len(frame), len(data)))
+
+        # The seek table goes in a skippable frame at the end of the file, so
+        # regular zstd tools can still decompress it
+        table = b"".join(struct.pack("<II", c, d) for c, d in entries)
+        footer = struct.pack("<IBI", len(entries), 0, SEEK_TABLE_MAGIC)
+        out_file.write(
+            struct.pack("<II", SKIPPABLE_FRAME_MAGIC, len(table) + len(footer))
+        )
+        out_file.write(table)
+        out_file.write(footer)
+
+
+if __name__ == "__main__":
+    main()
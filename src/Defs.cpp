@@ -9,6 +9,9 @@
 
 #include <cmath>
 #include <algorithm>
+#include <random>
+#include <unordered_set>
+#include <vector>
 
 /**
  * Returns the number of elements that each chare will track at a minimum.
@@ -123,3 +126,73 @@ Id getLocalIndex(Id globalIndex, PartitionId partitionIndex, Id numElements,
       numPartitions, offset);
   return globalIndex - firstLocalIndex;
 }
+
+/**
+ * Returns the PE a chare is placed on. Chares are placed in contiguous
+ * blocks, the same way the default block map would place them.
+ *
+ * Args:
+ *    Id partitionIndex: The index of the chare.
+ *    Id numPartitions: The total number of chares.
+ *
+ */
+int getPartitionPe(PartitionId partitionIndex, PartitionId numPartitions) {
+  return static_cast<Id>(partitionIndex) * CkNumPes() / numPartitions;
+}
+
+/**
+ * Finds the chare holding an object and the object's index on that chare
+ * using only integer math, so that senders can address objects directly.
+ *
+ * Args:
+ *    Id globalIndex: The global unique object identifier.
+ *    Id numElementsPerPartition: From getNumElementsPerPartition.
+ *    Id numPartitions: The total number of chares.
+ *    Id offset: The globalIndex number referring to the first object.
+ *    PartitionId *partitionIndex: Set to the index of the chare.
+ *    uint32_t *localIndex: Set to the object's index on the chare.
+ *
+ */
+void getPartitionSlot(Id globalIndex, Id numElementsPerPartition,
+    PartitionId numPartitions, Id offset, PartitionId *partitionIndex,
+    uint32_t *localIndex) {
+  Id relativeIndex = globalIndex - offset;
+  Id partition = std::min<Id>(relativeIndex / numElementsPerPartition,
+      numPartitions - 1);
+  *partitionIndex = static_cast<PartitionId>(partition);
+  *localIndex = static_cast<uint32_t>(relativeIndex
+      - partition * numElementsPerPartition);
+}
+
+/**
+ * Returns the people to seed infections in, which are taken from the back,
+ * INITIAL_INFECTIONS_PER_DAY at a time, on each of the first
+ * DAYS_TO_SEED_INFECTION days. The same seed always gives the same people.
+ *
+ * Args:
+ *    int seed: The seed for the simulation's random numbers.
+ *    Id numElements: The total number of people.
+ *    Id offset: The global unique identifier of the first person.
+ */
+std::vector<Id> getInitialInfections(int seed, Id numElements, Id offset) {
+  std::default_random_engine generator(seed);
+  std::uniform_int_distribution<Id> personDistrib(offset,
+      offset + numElements - 1);
+  std::vector<Id> initialInfections;
+  std::unordered_set<Id> initialInfectionsSet;
+  initialInfections.reserve(INITIAL_INFECTIONS);
+  // Use set to check membership becuase it's faster and we can spare the
+  // memory; INITIAL_INFECTIONS should be fairly small
+  initialInfectionsSet.reserve(INITIAL_INFECTIONS);
+  while (initialInfectionsSet.size() < INITIAL_INFECTIONS
+      // This loop will go forever on small test populations without
+      // this check
+      && initialInfectionsSet.size() < numElements) {
+    Id personIdx = personDistrib(generator);
+    if (initialInfectionsSet.count(personIdx) == 0) {
+      initialInfections.emplace_back(personIdx);
+      initialInfectionsSet.emplace(personIdx);
+    }
+  }
+  return initialInfections;
+}
@@ -12,6 +12,7 @@
 #include "pup.h"
 
 #include "Types.h"
+#include <cstdint>
 #include <limits>
 
 // Concat two parts of variable names (for use with other macros)
@@ -52,6 +53,14 @@ const Time MINUTE_LENGTH = 60;
 // Indices of attribute columns in the appropriate csvs
 #define AGE_CSV_INDEX 0
 
+// Names of the attributes looked up in the person and location csvs
+#define AGE_ATTRIBUTE "age"
+#define SUSCEPTIBILITY_ATTRIBUTE "susceptibility"
+#define INFECTIVITY_ATTRIBUTE "infectivity"
+#define VACCINATED_ATTRIBUTE "vaccinated"
+#define SCHOOL_ATTRIBUTE "school"
+#define MAX_SIM_VISITS_ATTRIBUTE "max_simultaneous_visits"
+
 // Data loading
 #define EMPTY_VISIT_SCHEDULE std::numeric_limits<CacheOffset>::max()
 #define CSV_DELIM ','
@@ -76,5 +85,10 @@ Id getGlobalIndex(Id localIndex, PartitionId partitionIndex, Id numElements,
     PartitionId numPartitions, Id offset);
 Id getLocalIndex(Id globalIndex, PartitionId partitionIndex, Id numElements,
     PartitionId numPartitions, Id offset);
+int getPartitionPe(PartitionId partitionIndex, PartitionId numPartitions);
+void getPartitionSlot(Id globalIndex, Id numElementsPerPartition,
+    PartitionId numPartitions, Id offset, PartitionId *partitionIndex,
+    uint32_t *localIndex);
+std::vector<Id> getInitialInfections(int seed, Id numElements, Id offset);
 
 #endif  // DEFS_H_
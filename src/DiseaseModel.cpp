@@ -42,6 +42,7 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 // This is currently used to adjust the infection probability so that
 // not everyone gets infected immediately given the small time units
@@ -71,6 +72,22 @@ DiseaseModel::DiseaseModel(std::string pathToModel, std::string scenarioPath,
   diseaseModelStream.close();
   assert(model->disease_states_size() != 0);
 
+  // The interventions are needed to know which attributes to load
+  if (interventionStategy) {
+    interventionDef = new loimos::proto::InterventionModel();
+    std::ifstream interventionActivityStream(pathToIntervention);
+    if (!interventionActivityStream)
+      CkAbort("Could not open intervention textproto!");
+    std::string interventionString((std::istreambuf_iterator<char>(
+            interventionActivityStream)),
+                    std::istreambuf_iterator<char>());
+    if (!google::protobuf::TextFormat::ParseFromString(interventionString,
+          interventionDef)) {
+      CkAbort("Could not parse protobuf!");
+    }
+    interventionActivityStream.close();
+  }
+
   // Setup other shared PE objects.
   if (!syntheticRun) {
     // Handle people...
@@ -84,7 +101,14 @@ DiseaseModel::DiseaseModel(std::string pathToModel, std::string scenarioPath,
       CkAbort("Could not parse person protobuf!");
     }
     personInputStream.close();
-    ageIdx = DataReader<>::getAttributeIndex(personDef, "age");
+    int numSkippedColumns = projectColumns(getUsedPersonAttributes(),
+        personDef);
+#if ENABLE_DEBUG >= DEBUG_VERBOSE
+    if (0 == CkMyNode()) {
+      CkPrintf("  Skipping %d unused person attributes\n", numSkippedColumns);
+    }
+#endif
+    ageIdx = DataReader<>::getAttributeIndex(personDef, AGE_ATTRIBUTE);
 #if ENABLE_DEBUG >= DEBUG_VERBOSE
     if (0 == CkMyNode()) {
     CkPrintf("  Age to be stored at index %d\n",
@@ -105,12 +129,21 @@ DiseaseModel::DiseaseModel(std::string pathToModel, std::string scenarioPath,
       CkAbort("Could not parse location protobuf!");
     }
     locationInputStream.close();
+    numSkippedColumns = projectColumns(getUsedLocationAttributes(),
+        locationDef);
+#if ENABLE_DEBUG >= DEBUG_VERBOSE
+    if (0 == CkMyNode()) {
+      CkPrintf("  Skipping %d unused location attributes\n",
+          numSkippedColumns);
+    }
+#endif
 
     if (static_cast<int>(ContactModelType::min_max_alpha) == contactModelType) {
       maxSimVisitsIdx = DataReader<>::getAttributeIndex(locationDef,
-          "max_simultaneous_visits");
+          MAX_SIM_VISITS_ATTRIBUTE);
       if (-1 == maxSimVisitsIdx) {
-        CkAbort("Error: required attribute \"max_simultaneous_visits\" not present\n");
+        CkAbort("Error: required attribute \"%s\" not present\n",
+            MAX_SIM_VISITS_ATTRIBUTE);
       } else {
 #if ENABLE_DEBUG >= DEBUG_VERBOSE
         if (0 == CkMyNode()) {
@@ -137,22 +170,13 @@ DiseaseModel::DiseaseModel(std::string pathToModel, std::string scenarioPath,
 
     personAttributes.readAttributes(personDef->fields());
     locationAttributes.readAttributes(locationDef->fields());
+
+    personPlan = new ParsePlan(*personDef);
+    locationPlan = new ParsePlan(*locationDef);
+    activityPlan = new ParsePlan(*activityDef);
   }
 
   if (interventionStategy) {
-    interventionDef = new loimos::proto::InterventionModel();
-    std::ifstream interventionActivityStream(pathToIntervention);
-    if (!interventionActivityStream)
-      CkAbort("Could not open intervention textproto!");
-    std::string interventionString((std::istreambuf_iterator<char>(
-            interventionActivityStream)),
-                    std::istreambuf_iterator<char>());
-    if (!google::protobuf::TextFormat::ParseFromString(interventionString,
-          interventionDef)) {
-      CkAbort("Could not parse protobuf!");
-    }
-    interventionActivityStream.close();
-
     triggerFlags.resize(interventionDef->triggers_size(), false);
 
     personAttributes.readAttributes(interventionDef->person_attributes());
@@ -165,8 +189,50 @@ DiseaseModel::DiseaseModel(std::string pathToModel, std::string scenarioPath,
         locationAttributes);
   }
 
-  susceptibilityIndex = personAttributes.getAttributeIndex("susceptibility");
-  infectivityIndex = personAttributes.getAttributeIndex("infectivity");
+  susceptibilityIndex = personAttributes.getAttributeIndex(
+      SUSCEPTIBILITY_ATTRIBUTE);
+  infectivityIndex = personAttributes.getAttributeIndex(INFECTIVITY_ATTRIBUTE);
+}
+
+/**
+ * Returns the names of every person attribute the simulation looks up. Any
+ * other columns in the person csv are never read, so they aren't loaded
+ */
+std::unordered_set<std::string> DiseaseModel::getUsedPersonAttributes()
+    const {
+  // Used by getHealthyState and getPropensity
+  std::unordered_set<std::string> used = {AGE_ATTRIBUTE,
+    SUSCEPTIBILITY_ATTRIBUTE, INFECTIVITY_ATTRIBUTE};
+  if (interventionStategy) {
+    for (const auto &spec : interventionDef->person_interventions()) {
+      std::vector<std::string> attributes;
+      if (spec.has_self_isolation()) {
+        attributes = SelfIsolationIntervention::getUsedAttributes();
+      } else if (spec.has_vaccination()) {
+        attributes = VaccinationIntervention::getUsedAttributes();
+      }
+      used.insert(attributes.begin(), attributes.end());
+    }
+  }
+  return used;
+}
+
+/**
+ * Returns the names of every location attribute the simulation looks up
+ */
+std::unordered_set<std::string> DiseaseModel::getUsedLocationAttributes()
+    const {
+  std::vector<std::string> attributes = getContactModelAttributes();
+  std::unordered_set<std::string> used(attributes.begin(), attributes.end());
+  if (interventionStategy) {
+    for (const auto &spec : interventionDef->location_interventions()) {
+      if (spec.has_school_closures()) {
+        attributes = SchoolClosureIntervention::getUsedAttributes();
+        used.insert(attributes.begin(), attributes.end());
+      }
+    }
+  }
+  return used;
 }
 
 void DiseaseModel::intitialisePersonInterventions(
@@ -183,7 +249,15 @@ void DiseaseModel::intitialisePersonInterventions(
     } else if (spec.has_vaccination()) {
       personInterventions.emplace_back(new VaccinationIntervention(
         spec, *model, attributes));
+
+    } else {
+      continue;
     }
+    personInterventions.back()->setIndex(personInterventions.size() - 1);
+  }
+  if (MAX_INTERVENTIONS < personInterventions.size()) {
+    CkAbort("Error: at most %d person interventions are supported\n",
+        MAX_INTERVENTIONS);
   }
 }
 
@@ -197,8 +271,14 @@ void DiseaseModel::intitialiseLocationInterventions(
     if (spec.has_school_closures()) {
       locationInterventions.emplace_back(new SchoolClosureIntervention(
         spec, *model, attributes));
+      locationInterventions.back()->setIndex(
+          locationInterventions.size() - 1);
     }
   }
+  if (MAX_INTERVENTIONS < locationInterventions.size()) {
+    CkAbort("Error: at most %d location interventions are supported\n",
+        MAX_INTERVENTIONS);
+  }
 }
 
 /**
@@ -341,7 +421,7 @@ int DiseaseModel::getNumberOfStates() const {
 }
 
 /** Returns the initial starting healthy and exposed state */
-DiseaseState DiseaseModel::getHealthyState(const std::vector<Data> &dataField) const {
+DiseaseState DiseaseModel::getHealthyState(const Person &person) const {
   uint numStartingStates = model->starting_states_size();
 
   // Shouldn't need to check age if there's only one starting state
@@ -355,7 +435,7 @@ DiseaseState DiseaseModel::getHealthyState(const std::vector<Data> &dataField) c
   }
 
   // Age based transition.
-  int personAge = dataField[ageIdx].int32_val;
+  int personAge = person.getValue(ageIdx).int32_val;
   for (uint stateNum = 0; stateNum < numStartingStates; stateNum++) {
     const loimos::proto::DiseaseModel_StartingCondition state =
       model->starting_states(stateNum);
@@ -403,7 +483,7 @@ double DiseaseModel::getLogProbNotInfected(Event susceptibleEvent,
   // The probability of not being infected in a period of time is decided based
   // on a geometric probability distribution, with the lenght of time the two
   // people are in the same location serving as the number of trials
-  Time dt = abs(susceptibleEvent.scheduledTime - infectiousEvent.scheduledTime);
+  Time dt = abs(susceptibleEvent.getTime() - infectiousEvent.getTime());
   return log(baseProb) * dt;
 }
 
@@ -15,12 +15,14 @@
 #include "protobuf/data.pb.h"
 #include "protobuf/interventions.pb.h"
 #include "readers/DataReader.h"
+#include "readers/ParsePlan.h"
 #include "readers/DataInterface.h"
 #include "readers/AttributeTable.h"
 #include "intervention_model/Intervention.h"
 #include "Event.h"
 
 #include <unordered_map>
+#include <unordered_set>
 #include <random>
 #include <tuple>
 #include <string>
@@ -49,6 +51,8 @@ void intitialisePersonInterventions(
 void intitialiseLocationInterventions(
     const InterventionList &interventionSpecs,
     const AttributeTable &attributes);
+  std::unordered_set<std::string> getUsedPersonAttributes() const;
+  std::unordered_set<std::string> getUsedLocationAttributes() const;
 
  public:
   // move back to private later
@@ -60,7 +64,7 @@ void intitialiseLocationInterventions(
     std::default_random_engine *generator) const;
   std::string lookupStateName(DiseaseState state) const;
   int getNumberOfStates() const;
-  DiseaseState getHealthyState(const std::vector<Data> &dataField) const;
+  DiseaseState getHealthyState(const Person &person) const;
   bool isInfectious(DiseaseState personState) const;
   bool isSusceptible(DiseaseState personState) const;
   const char * getStateLabel(DiseaseState personState) const;
@@ -79,6 +83,10 @@ void intitialiseLocationInterventions(
   loimos::proto::CSVDefinition *locationDef;
   loimos::proto::CSVDefinition *activityDef;
   loimos::proto::InterventionModel *interventionDef;
+  // Compiled versions of the above csv definitions
+  ParsePlan *personPlan;
+  ParsePlan *locationPlan;
+  ParsePlan *activityPlan;
 
   // Intervention methods
   int susceptibilityIndex;
@@ -7,44 +7,56 @@
 #include "loimos.decl.h"
 #include "Event.h"
 
-// This is just so that we can order Events in the Location queues
-bool Event::operator<(const Event& rhs) const {
-  // First compare times...
-  if (scheduledTime != rhs.scheduledTime) {
-    return scheduledTime < rhs.scheduledTime;
-  }
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 
-  // .. then break ties with the type...
-  if (type != rhs.type) {
-    return type < rhs.type;
+Event::Event(EventType type, uint32_t visitIdx_, DiseaseState personState_,
+    Time scheduledTime, Time partnerTime_) : visitIdx(visitIdx_),
+    partnerTime(partnerTime_), personState(personState_) {
+  key = (static_cast<uint32_t>(scheduledTime) << 1)
+    | (ARRIVAL == type ? 1 : 0);
+}
+
+// This is just so that we can order Events in the Location queues
+bool Event::less(const Event &e0, const Event &e1,
+    const std::vector<Id> &visitors) {
+  // First compare times, breaking ties with the type...
+  if (e0.key != e1.key) {
+    return e0.key < e1.key;
   }
 
   // ...then break ties with the visitor's index...
-  if (personIdx != rhs.personIdx) {
-    return personIdx < rhs.personIdx;
+  Id person0 = visitors[e0.visitIdx];
+  Id person1 = visitors[e1.visitIdx];
+  if (person0 != person1) {
+    return person0 < person1;
   }
 
   // ...then finally break ties with the visitor's state
-  return personState < rhs.personState;
+  return e0.personState < e1.personState;
 }
 
 // Compares two events based on the correspodning other event (if one is an
 // arrival, the matching departure, and vice versa)
-bool Event::greaterPartner(const Event &e0, const Event &e1) {
+bool Event::greaterPartner(const Event &e0, const Event &e1,
+    const std::vector<Id> &visitors) {
   // First compare times...
   if (e0.partnerTime != e1.partnerTime) {
     return e0.partnerTime > e1.partnerTime;
   }
 
   // ...then break ties with the types...
-  if (e0.type != e1.type) {
+  if (e0.getType() != e1.getType()) {
     // equivalent of comparing the opposite types
-    return e0.type < e1.type;
+    return e0.getType() < e1.getType();
   }
 
   // ...then break ties with the visitor's index...
-  if (e0.personIdx != e1.personIdx) {
-    return e0.personIdx > e1.personIdx;
+  Id person0 = visitors[e0.visitIdx];
+  Id person1 = visitors[e1.visitIdx];
+  if (person0 != person1) {
+    return person0 > person1;
   }
 
   // ...and finally breka ties with the vistior's state
@@ -53,18 +65,18 @@ bool Event::greaterPartner(const Event &e0, const Event &e1) {
 
 bool Event::overlap(const Event &e0, const Event &e1) {
   int start0, end0, start1, end1;
-  if (ARRIVAL == e0.type) {
-    start0 = e0.scheduledTime;
+  if (ARRIVAL == e0.getType()) {
+    start0 = e0.getTime();
     end0 = e0.partnerTime;
   } else {
-    end0 = e0.scheduledTime;
+    end0 = e0.getTime();
     start0 = e0.partnerTime;
   }
-  if (ARRIVAL == e1.type) {
-    start1 = e1.scheduledTime;
+  if (ARRIVAL == e1.getType()) {
+    start1 = e1.getTime();
     end1 = e1.partnerTime;
   } else {
-    end1 = e1.scheduledTime;
+    end1 = e1.getTime();
     start1 = e1.partnerTime;
   }
 
@@ -72,7 +84,62 @@ bool Event::overlap(const Event &e0, const Event &e1) {
     || (start0 > start1 && end1 > start0);
 }
 
-void Event::pair(Event *e0, Event *e1) {
-  e0->partnerTime = e1->scheduledTime;
-  e1->partnerTime = e0->scheduledTime;
+void Event::sort(std::vector<Event> *events, std::vector<Event> *buffer,
+    const std::vector<Id> &visitors) {
+  auto byKey = [&visitors](const Event &e0, const Event &e1) {
+    return Event::less(e0, e1, visitors);
+  };
+  if (events->size() < RADIX_SORT_MIN_EVENTS) {
+    std::sort(events->begin(), events->end(), byKey);
+    return;
+  }
+
+  // Times are bounded, so only the passes covering the largest key's bits
+  // are needed (two for any visits ending within a day)
+  uint32_t maxKey = 0;
+  for (const Event &event : *events) {
+    maxKey = std::max(maxKey, event.key);
+  }
+
+  const uint32_t numBuckets = 1 << RADIX_SORT_BITS;
+  const uint32_t mask = numBuckets - 1;
+  uint32_t counts[numBuckets];
+  buffer->resize(events->size());
+  Event *from = events->data();
+  Event *to = buffer->data();
+  size_t numEvents = events->size();
+  for (int shift = 0; shift < 32 && 0 != (maxKey >> shift);
+      shift += RADIX_SORT_BITS) {
+    std::fill(counts, counts + numBuckets, 0);
+    for (size_t i = 0; i < numEvents; ++i) {
+      counts[(from[i].key >> shift) & mask]++;
+    }
+    uint32_t total = 0;
+    for (uint32_t b = 0; b < numBuckets; ++b) {
+      uint32_t count = counts[b];
+      counts[b] = total;
+      total += count;
+    }
+    for (size_t i = 0; i < numEvents; ++i) {
+      to[counts[(from[i].key >> shift) & mask]++] = from[i];
+    }
+    std::swap(from, to);
+  }
+  if (from != events->data()) {
+    events->swap(*buffer);
+  }
+
+  // The radix sort is stable, so events with the same key are still in the
+  // order their visits arrived in; put them in a consistent order instead
+  auto start = events->begin();
+  while (start != events->end()) {
+    auto end = start + 1;
+    while (end != events->end() && end->key == start->key) {
+      ++end;
+    }
+    if (1 < end - start) {
+      std::sort(start, end, byKey);
+    }
+    start = end;
+  }
 }
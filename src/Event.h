@@ -9,37 +9,63 @@
 
 #include "charm++.h"
 #include "Defs.h"
+#include "Types.h"
+
+#include <cstdint>
+#include <vector>
+
+// Locations with fewer events than this are sorted with std::sort, since
+// clearing the radix sort's counts would cost more than the sort itself
+#define RADIX_SORT_MIN_EVENTS 256
+// Number of bits of the sort key handled by each radix sort pass
+#define RADIX_SORT_BITS 11
 
 // This is just a bundle of information that we don't need to
 // guarentee any constraints on, hence why this is a stuct rather than
-// a class
+// a class. It's packed into 16 bytes so that sorting a busy location's
+// events moves as little memory as possible; everything about the visit
+// which isn't needed to order events lives in its location's side arrays
 struct Event {
-  // indicates whether they're arriving or leaving
-  EventType type;
-  // the index of the person arriving or leaving
-  int personIdx;
-  // the person's curent state in the disease model
-  int personState;
-  // Susceptibility or infectivity, depending on disease state
-  double transmissionModifier;
-  // the time when this event is scheduled to occur, in seconds from the
-  // start of the day
-  int scheduledTime;
+  // The time when this event is scheduled to occur, in seconds from the
+  // start of the day, shifted up one bit to make room for its type. Events
+  // can be ordered by this alone, with departures coming before arrivals
+  // at the same time
+  uint32_t key;
+  // Which of the location's visits today this event is part of
+  uint32_t visitIdx;
   // if this is an arrival, the time of the corresponding departure,
   // and vice versa
-  int partnerTime;
+  Time partnerTime;
+  // the person's curent state in the disease model
+  DiseaseState personState;
+
+  Event() {}
+  Event(EventType type, uint32_t visitIdx, DiseaseState personState,
+      Time scheduledTime, Time partnerTime);
+
+  inline EventType getType() const {
+    return static_cast<EventType>(key & 1);
+  }
+  inline Time getTime() const {
+    return static_cast<Time>(key >> 1);
+  }
 
-  // Lets us order events in the location queues
-  bool operator<(const Event& rhs) const;
+  // Orders events by their keys, and then the ids and states of the people
+  // making them, so that ties don't depend on the order visits arrive in
+  static bool less(const Event &e0, const Event &e1,
+      const std::vector<Id> &visitors);
 
   // Compares events based on their partners, returning whether or not e0's
-  // partner is greater than e1's. Assumes both partnes are non-null
-  static bool greaterPartner(const Event &e0, const Event &e1);
+  // partner is greater than e1's
+  static bool greaterPartner(const Event &e0, const Event &e1,
+      const std::vector<Id> &visitors);
 
   static bool overlap(const Event &e0, const Event &e1);
 
-  // Makes two events each others' partners
-  static void pair(Event *e0, Event *e1);
+  // Sorts events by less(), using a stable LSD radix sort over the keys for
+  // all but the smallest lists. buffer is used as scratch space
+  static void sort(std::vector<Event> *events, std::vector<Event> *buffer,
+      const std::vector<Id> &visitors);
 };
 PUPbytes(Event);
 
@@ -18,6 +18,7 @@ extern /* readonly */ CProxy_Locations locationsArray;
 extern /* readonly */ CProxy_Aggregator aggregatorProxy;
 #endif
 extern /* readonly */ CProxy_DiseaseModel globDiseaseModel;
+extern /* readonly */ CProxy_PopulationReader globPopulationReader;
 extern /* readonly */ int numPeople;
 extern /* readonly */ int numLocations;
 extern /* readonly */ int numPeoplePartitions;
@@ -26,8 +27,14 @@ extern /* readonly */ int numPeoplePerPartition;
 extern /* readonly */ int numLocationsPerPartition;
 extern /* readonly */ int numDays;
 extern /* readonly */ int numDaysWithDistinctVisits;
+extern /* readonly */ int visitWindow;
+extern /* readonly */ bool aggregateExposures;
+extern /* readonly */ bool infectiousFirst;
+extern /* readonly */ bool residentVisits;
+extern /* readonly */ bool countedPhases;
 extern /* readonly */ int contactModelType;
 extern /* readonly */ bool syntheticRun;
+extern /* readonly */ bool binaryInput;
 
 extern /* readonly */ Counter totalVisits;
 extern /* readonly */ Counter totalInteractions;
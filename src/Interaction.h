@@ -7,31 +7,52 @@
 #ifndef INTERACTION_H_
 #define INTERACTION_H_
 
+#include "Types.h"
+#include "Defs.h"
 #include "charm++.h"
 
 // Simple struct to hold data on an interfaction between with a susceptible
-// person which could lead to an infection
+// person which could lead to an infection. Every field is kept at full
+// precision, so this is the same 24 bytes as it always was; what's saved is
+// in how they're sent, as one batch per People chare rather than one
+// message per person
 struct Interaction {
-  // Describes the chance of this interaction resulting in an infection
+  // Describes the chance of this interaction resulting in an infection. This
+  // is kept in full precision, since aggregated exposures sum many of them
   double propensity;
   // Data on the person who could potentially infect the susceptible person in
   // question
   int infectiousIdx;
-  int infectiousState;
   // We need to know when the interaction occured so that, if this interaction
   // does in fact result in an infection, we can determine precisely when it
   // occurred
-  int startTime;
-  int endTime;
+  Time startTime;
+  Time endTime;
+  DiseaseState infectiousState;
 
   Interaction() {}
   Interaction(double propensity_, int infectiousIdx_,
-      int infectiousState_, int startTime_, int endTime_) :
+      DiseaseState infectiousState_, Time startTime_, Time endTime_) :
     propensity(propensity_), infectiousIdx(infectiousIdx_),
-    infectiousState(infectiousState_), startTime(startTime_),
-    endTime(endTime_) {}
+    startTime(startTime_), endTime(endTime_),
+    infectiousState(infectiousState_) {}
   explicit Interaction(CkMigrateMessage *msg) {}
 
+  // Folds other into this interaction, which then stands in for both: the
+  // propensities are summed, and the rest describes one of the two, chosen
+  // with probability proportional to its propensity using roll (uniform on
+  // [0, 1)). Folding in a whole list this way leaves a weighted reservoir
+  // sample of its interactions, starting from a propensity of zero
+  inline void accumulate(const Interaction &other, double roll) {
+    propensity += other.propensity;
+    if (roll * propensity < other.propensity) {
+      infectiousIdx = other.infectiousIdx;
+      infectiousState = other.infectiousState;
+      startTime = other.startTime;
+      endTime = other.endTime;
+    }
+  }
+
   void pup(PUP::er& p) {  // NOLINT(runtime/references)
     p | propensity;
     p | infectiousIdx;
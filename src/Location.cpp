@@ -9,7 +9,8 @@
 #include "Location.h"
 #include "Event.h"
 #include "Defs.h"
-#include "readers/AttributeTable.h"
+#include "Extern.h"
+#include "readers/AttributeStore.h"
 
 #ifdef USE_HYPERCOMM
   #include "Aggregator.h"
@@ -21,38 +22,38 @@
 #include <utility>
 #include <algorithm>
 
-Location::Location(const AttributeTable &attributes,
-    int numInterventions, int uniqueId_) :
-    DataInterface(attributes, numInterventions) {
+Location::Location(AttributeStore *store, Id row, Id uniqueId_) :
+    DataInterface(store, row) {
   setUniqueId(uniqueId_);
 }
 
 Location::Location(CkMigrateMessage *msg) {}
 
 void Location::pup(PUP::er &p) {
-  p | data;
   p | uniqueId;
+  p | row;
+  p | visitFilters;
   p | events;
+  p | visitors;
+  p | transmissionModifiers;
+  p | visitorSlots;
+  p | residentDays;
 }
 
 // Event processing.
-void Location::addEvent(const Event &e) {
-  events.push_back(e);
+void Location::addVisit(const VisitMessage &visit) {
+  uint32_t visitIdx = static_cast<uint32_t>(visitors.size());
+  Time start = visit.visitStart;
+  Time end = visit.visitEnd;
+  visitors.push_back(firstPersonIdx + visit.personOffset);
+  transmissionModifiers.push_back(visit.transmissionModifier);
+  events.emplace_back(ARRIVAL, visitIdx, visit.personState, start, end);
+  events.emplace_back(DEPARTURE, visitIdx, visit.personState, end, start);
 }
 
-void Location::filterVisits(const void *cause, VisitTest keepVisit) {
-  visitFilters[cause] = keepVisit;
-}
-
-void Location::restoreVisits(const void *cause) {
-  visitFilters.erase(cause);
-}
-
-bool Location::acceptsVisit(const VisitMessage &visit) {
-  for (const std::pair<const void *, VisitTest> &pair : visitFilters) {
-    if (!pair.second(visit)) {
-      return false;
-    }
-  }
-  return true;
+void Location::clearVisits() {
+  events.clear();
+  visitors.clear();
+  transmissionModifiers.clear();
+  visitorSlots.clear();
 }
@@ -12,8 +12,9 @@ class Location;
 
 #include "Types.h"
 #include "Event.h"
-#include "readers/AttributeTable.h"
+#include "readers/AttributeStore.h"
 #include "readers/DataInterface.h"
+#include "pup_stl.h"
 
 #include <vector>
 #include <functional>
@@ -29,8 +30,26 @@ class Location : public DataInterface {
   // Represents all of the arrivals and departures of people
   // from this location on a given day
   std::vector<Event> events;
-  std::unordered_map<const void *, VisitTest> visitFilters;
+  // Who made each of today's visits and their susceptibility or
+  // infectivity, indexed by the events' visitIdx
+  std::vector<Id> visitors;
+  std::vector<double> transmissionModifiers;
+  // Only used with residentVisits: the visitor slot (see Locations) of
+  // each of today's visits, and each day of the visit schedule's events,
+  // sorted once and kept for the rest of the simulation
+  std::vector<uint32_t> visitorSlots;
+  struct ResidentDay {
+    std::vector<Event> events;
+    std::vector<Id> visitors;
+    std::vector<uint32_t> visitorSlots;
 
+    void pup(PUP::er &p) {  // NOLINT(runtime/references)
+      p | events;
+      p | visitors;
+      p | visitorSlots;
+    }
+  };
+  std::vector<ResidentDay> residentDays;
 
   // This distribution should always be the same - not sure how well
   // static variables work with Charm++, so this may need to be put
@@ -39,8 +58,7 @@ class Location : public DataInterface {
   // Provide default constructor operations.
   Location() = default;
   explicit Location(CkMigrateMessage *msg);
-  Location(const AttributeTable &attributes, int numInterventions,
-    int uniqueId);
+  Location(AttributeStore *store, Id row, Id uniqueId);
   Location(const Location&) = default;
   Location(Location&&) = default;
   ~Location() = default;
@@ -54,12 +72,15 @@ class Location : public DataInterface {
   // Lets us migrate these objects
   void pup(PUP::er &p);  // NOLINT(runtime/references)
 
-  // Adds an event representing a person either arriving or departing
+  // Adds the events representing a person arriving at and departing
   // from this location
-  void addEvent(const Event &e);
-  void filterVisits(const void *cause, VisitTest keepVisit) override;
-  void restoreVisits(const void *cause) override;
-  bool acceptsVisit(const VisitMessage &visit);
+  void addVisit(const VisitMessage &visit);
+  // Forgets all of today's visits once they've been processed
+  void clearVisits();
+  // Whether or not any interventions are cancelling visits here
+  inline bool acceptsVisits() const {
+    return 0 == visitFilters;
+  }
 };
 
 #endif  // LOCATION_H_
@@ -18,6 +18,9 @@
 #include "contact_model/ContactModel.h"
 #include "readers/Preprocess.h"
 #include "readers/DataReader.h"
+#include "readers/BinaryFormat.h"
+#include "readers/LineReader.h"
+#include "readers/PopulationReader.h"
 #include "intervention_model/Intervention.h"
 #include "pup_stl.h"
 
@@ -55,18 +58,24 @@ Locations::Locations(int seed, std::string scenarioPath) {
 
   // Seed random number generator via branch ID for reproducibility
   generator.seed(seed + thisIndex);
+  outgoingInteractions.resize(numPeoplePartitions);
+  receivedVisitMessages = 0;
+  expectedVisitMessages = -1;
+  sentHotWindows = false;
+  sentInteractionMessages.resize(numPeoplePartitions, 0);
 
   // Init contact model
   contactModel = createContactModel();
   contactModel->setGenerator(&generator);
 
   int numInterventions = diseaseModel->getNumLocationInterventions();
+  attributeStore = AttributeStore(diseaseModel->locationAttributes,
+      numLocalLocations, numInterventions);
   locations.reserve(numLocalLocations);
   Id firstIdx = thisIndex * getNumElementsPerPartition(numLocations,
       numLocationPartitions);
   for (int p = 0; p < numLocalLocations; p++) {
-    locations.emplace_back(diseaseModel->locationAttributes,
-      numInterventions, firstIdx + p);
+    locations.emplace_back(&attributeStore, p, firstIdx + p);
   }
 
   // Load application data
@@ -106,34 +115,26 @@ void Locations::loadLocationData(std::string scenarioPath) {
   // Load in location information.
   Id startingLineIndex = getGlobalIndex(0, thisIndex, numLocations,
     numLocationPartitions, firstLocationIdx) - firstLocationIdx;
-  Id endingLineIndex = startingLineIndex + numLocalLocations;
   std::string line;
 
-  std::string scenarioId = getScenarioId(numPeople, numPeoplePartitions,
-    numLocations, numLocationPartitions);
-  std::ifstream locationData(scenarioPath + "locations.csv");
-  std::ifstream locationCache(scenarioPath + scenarioId
-    + "_locations.cache", std::ios_base::binary);
-  if (!locationData || !locationCache) {
-    CkAbort("Could not open person data input.");
-  }
-
-  // Find starting line for our data through location cache.
-  locationCache.seekg(thisIndex * sizeof(CacheOffset));
-  CacheOffset locationOffset;
-  locationCache.read(reinterpret_cast<char *>(&locationOffset), sizeof(CacheOffset));
-  locationData.seekg(locationOffset);
+  if (binaryInput) {
+    // Only map the rows for our own locations
+    BinaryReader locationData(scenarioPath + "locations"
+        + BINARY_FILE_SUFFIX);
+    DataReader<Location>::readBinaryData(&locationData, startingLineIndex,
+        diseaseModel->locationAttributes, &attributeStore, &locations);
 
-  // Read in our location data.
-  DataReader<Location>::readData(&locationData, diseaseModel->locationDef,
-      &locations);
-  locationData.close();
-  locationCache.close();
+  } else {
+    // Our node's reader does the actual I/O, so we only parse our own lines
+    PopulationReader *reader = globPopulationReader.ckLocalBranch();
+    LineReader locationReader = reader->getLocationsReader(thisIndex);
+    DataReader<Location>::readData(&locationReader,
+        *diseaseModel->locationPlan, &locations);
+    reader->releaseLocations();
+  }
 
   // Let contact model add any attributes it needs to the locations
-  for (Location &location : locations) {
-    contactModel->computeLocationValues(&location);
-  }
+  contactModel->computeLocationValues(&attributeStore);
 
 #if ENABLE_DEBUG >= DEBUG_PER_CHARE
   CkPrintf("  Chare %d took %f s to load locations\n", thisIndex,
@@ -143,53 +144,195 @@ void Locations::loadLocationData(std::string scenarioPath) {
 
 void Locations::pup(PUP::er &p) {
   p | numLocalLocations;
+  p | attributeStore;
   p | locations;
   p | generator;
   p | day;
+  p | visitorSlots;
+  p | slotStates;
+  p | slotModifiers;
+  p | slotFilters;
+  p | receivedVisitMessages;
+  p | expectedVisitMessages;
+  p | sentHotWindows;
+  p | sentInteractionMessages;
 
   if (p.isUnpacking()) {
     diseaseModel = globDiseaseModel.ckLocalBranch();
     contactModel = createContactModel();
     contactModel->setGenerator(&generator);
+    outgoingInteractions.resize(numPeoplePartitions);
+    for (Location &location : locations) {
+      location.setStore(&attributeStore);
+    }
+    // Any values the contact model computed came along with the store, so
+    // this just finds them again
+    contactModel->computeLocationValues(&attributeStore);
   }
 }
 
 void Locations::ReceiveVisitMessages(VisitMessage visitMsg) {
-  // adding person to location visit list
-  Id localLocIdx = getLocalIndex(visitMsg.locationIdx, thisIndex,
-    numLocations, numLocationPartitions, firstLocationIdx);
+  receiveVisit(visitMsg);
+  countVisitMessage();
+}
 
-  // Interventions might cause us to reject some visits
-  if (!locations[localLocIdx].acceptsVisit(visitMsg)) {
-    return;
+void Locations::ReceiveVisitBatch(int numVisits, VisitMessage *visits) {
+  for (int i = 0; i < numVisits; ++i) {
+    receiveVisit(visits[i]);
   }
+  countVisitMessage();
+}
+
+void Locations::ReceiveLargeVisitBatch(int numVisits, VisitMessage *visits) {
+  ReceiveVisitBatch(numVisits, visits);
+}
+
+inline void Locations::receiveVisit(const VisitMessage &visitMsg) {
+  // The sender already worked out which of our locations this is for
+  Id localLocIdx = visitMsg.locationOffset;
 
 #ifdef ENABLE_DEBUG
-  Id trueIdx = locations[localLocIdx].getUniqueId();
-  if (visitMsg.locationIdx != trueIdx) {
-    CkPrintf("Error on chare %d: Visit by person "ID_PRINT_TYPE
-        " to loc "ID_PRINT_TYPE" recieved by "
-        "loc "ID_PRINT_TYPE" (local "ID_PRINT_TYPE")\n",
-        thisIndex, visitMsg.personIdx, visitMsg.locationIdx, trueIdx,
-        localLocIdx);
+  if (numLocalLocations <= localLocIdx) {
+    CkAbort("Error on chare %d: visit to local location " ID_PRINT_TYPE
+        " recieved, but the chare only has " ID_PRINT_TYPE " locations\n",
+        thisIndex, localLocIdx, numLocalLocations);
   }
 #endif
 
-  // CkPrintf("    Chare %d: Person %d visiting loc %d from %d to %d\n",
-  //   thisIndex, visitMsg.personIdx, visitMsg.locationIdx,
-  //   //localLocIdx, numLocalLocations,
-  //   visitMsg.visitStart, visitMsg.visitEnd);
-
-  // Wrap visit info...
-  Event arrival { ARRIVAL, visitMsg.personIdx, visitMsg.personState,
-    visitMsg.transmissionModifier, visitMsg.visitStart };
-  Event departure { DEPARTURE, visitMsg.personIdx, visitMsg.personState,
-    visitMsg.transmissionModifier, visitMsg.visitEnd };
-  Event::pair(&arrival, &departure);
-
-  // ...and queue it up at the appropriate location
-  locations[localLocIdx].addEvent(arrival);
-  locations[localLocIdx].addEvent(departure);
+  // Resident visits are kept even if interventions cancel them today, since
+  // they might not be cancelled later
+  Location &loc = locations[localLocIdx];
+  if (residentVisits) {
+    uint32_t slot = getVisitorSlot(visitMsg.personOffset);
+    slotStates[slot] = visitMsg.personState;
+    slotModifiers[slot] = visitMsg.transmissionModifier;
+    loc.visitorSlots.push_back(slot);
+  } else if (!loc.acceptsVisits()) {
+    // Interventions might cause us to reject some visits
+    return;
+  }
+
+  // Queue up the visit's arrival and departure at the appropriate location
+  loc.addVisit(visitMsg);
+}
+
+void Locations::ReceiveVisitorUpdates(int numUpdates,
+    VisitorUpdate *updates) {
+  for (int i = 0; i < numUpdates; ++i) {
+    const VisitorUpdate &update = updates[i];
+    uint32_t slot = getVisitorSlot(update.personOffset);
+    slotStates[slot] = update.personState;
+    slotModifiers[slot] = update.transmissionModifier;
+    slotFilters[slot] = update.visitFilters;
+  }
+  countVisitMessage();
+}
+
+void Locations::ExpectVisitMessages(CkReductionMsg *msg) {
+  const int *counts = reinterpret_cast<const int *>(msg->getData());
+  expectedVisitMessages = counts[thisIndex];
+  delete msg;
+  checkVisitsComplete();
+}
+
+void Locations::countVisitMessage() {
+  if (countedPhases) {
+    ++receivedVisitMessages;
+    checkVisitsComplete();
+  }
+}
+
+void Locations::checkVisitsComplete() {
+  if (receivedVisitMessages != expectedVisitMessages) {
+    return;
+  }
+  receivedVisitMessages = 0;
+  expectedVisitMessages = -1;
+
+  if (infectiousFirst && !sentHotWindows) {
+    sentHotWindows = true;
+    SendHotWindows();
+  } else {
+    sentHotWindows = false;
+    ComputeInteractions();
+  }
+}
+
+uint32_t Locations::getVisitorSlot(uint32_t personOffset) {
+  auto inserted = visitorSlots.emplace(personOffset,
+      static_cast<uint32_t>(slotStates.size()));
+  if (inserted.second) {
+    slotStates.push_back(0);
+    slotModifiers.push_back(1.0);
+    slotFilters.push_back(0);
+  }
+  return inserted.first->second;
+}
+
+void Locations::storeResidentDay(Location *loc, int scheduleDay) {
+  Event::sort(&loc->events, &sortBuffer, loc->visitors);
+  loc->residentDays.resize(numDaysWithDistinctVisits);
+  Location::ResidentDay &resident = loc->residentDays[scheduleDay];
+  resident.events.swap(loc->events);
+  resident.visitors.swap(loc->visitors);
+  resident.visitorSlots.swap(loc->visitorSlots);
+  loc->clearVisits();
+}
+
+void Locations::loadResidentDay(Location *loc, int scheduleDay) {
+  if (loc->residentDays.empty() || !loc->acceptsVisits()) {
+    return;
+  }
+
+  // The events are already sorted, so they just need their visitors' latest
+  // states. Any visit filter cancels all of a visitor's resident visits
+  const Location::ResidentDay &resident = loc->residentDays[scheduleDay];
+  loc->visitors = resident.visitors;
+  loc->transmissionModifiers.resize(resident.visitors.size());
+  for (size_t v = 0; v < resident.visitors.size(); ++v) {
+    loc->transmissionModifiers[v] = slotModifiers[resident.visitorSlots[v]];
+  }
+  loc->events.reserve(resident.events.size());
+  for (const Event &event : resident.events) {
+    uint32_t slot = resident.visitorSlots[event.visitIdx];
+    if (0 != slotFilters[slot]) {
+      continue;
+    }
+    loc->events.push_back(event);
+    loc->events.back().personState = slotStates[slot];
+  }
+}
+
+void Locations::SendHotWindows() {
+  // Only infectious visits have arrived so far. Each location's visits are
+  // merged into disjoint windows, so People can look them up quickly
+  Id firstLocalOffset = getFirstIndex(thisIndex, numLocations,
+      numLocationPartitions, 0);
+  std::vector<HotWindow> windows;
+  std::vector<std::pair<Time, Time> > spans;
+  for (Id i = 0; i < numLocalLocations; ++i) {
+    spans.clear();
+    for (const Event &event : locations[i].events) {
+      if (ARRIVAL == event.getType()) {
+        spans.emplace_back(event.getTime(), event.partnerTime);
+      }
+    }
+    std::sort(spans.begin(), spans.end());
+
+    uint32_t locationOffset = static_cast<uint32_t>(firstLocalOffset + i);
+    for (size_t s = 0; s < spans.size();) {
+      Time start = spans[s].first;
+      Time end = spans[s].second;
+      for (++s; s < spans.size() && spans[s].first <= end; ++s) {
+        end = std::max(end, spans[s].second);
+      }
+      windows.emplace_back(locationOffset, start, end);
+    }
+  }
+
+  CkCallback cb(CkReductionTarget(People, ReceiveHotWindows), peopleArray);
+  contribute(windows.size() * sizeof(HotWindow), windows.data(),
+      CkReduction::concat, cb);
 }
 
 void Locations::ComputeInteractions() {
@@ -199,7 +342,17 @@ void Locations::ComputeInteractions() {
   // traverses list of locations
   Counter numVisits = 0;
   Counter numInteractions = 0;
+  int scheduleDay = day % numDaysWithDistinctVisits;
   for (Location &loc : locations) {
+    // Visits only arrive during the first week of resident schedules, and
+    // are then replayed with their visitors' latest states
+    if (residentVisits) {
+      if (day < numDaysWithDistinctVisits) {
+        storeResidentDay(&loc, scheduleDay);
+      }
+      loadResidentDay(&loc, scheduleDay);
+    }
+
     Counter locVisits = loc.events.size() / 2;
     numVisits += locVisits;
 
@@ -211,6 +364,14 @@ void Locations::ComputeInteractions() {
     //       thisIndex, loc.getUniqueId(), locInters, locVisits);
     // }
   }
+  sendInteractionBatches();
+  if (countedPhases) {
+    CkCallback cb(CkReductionTarget(People, ExpectInteractionMessages),
+        peopleArray);
+    contribute(sentInteractionMessages, CkReduction::sum_int, cb);
+    std::fill(sentInteractionMessages.begin(),
+        sentInteractionMessages.end(), 0);
+  }
 #if ENABLE_DEBUG >= DEBUG_VERBOSE
   CkCallback cb(CkReductionTarget(Main, ReceiveInteractionsCount), mainProxy);
   contribute(sizeof(Counter), &numInteractions,
@@ -237,10 +398,25 @@ Counter Locations::processEvents(Location *loc) {
   double startTime = CkWallTimer();
   #endif
 
-  std::sort(loc->events.begin(), loc->events.end());
+  const std::vector<Id> &visitors = loc->visitors;
+  auto greaterPartner = [&visitors](const Event &e0, const Event &e1) {
+    return Event::greaterPartner(e0, e1, visitors);
+  };
+
+  // Resident events were sorted when they were stored
+  if (!residentVisits) {
+    Event::sort(&loc->events, &sortBuffer, visitors);
+  }
+  size_t numLocVisits = visitors.size();
+  if (aggregateExposures) {
+    exposures.assign(numLocVisits, Interaction(0.0, -1, -1, 0, 0));
+  } else {
+    firstInteraction.assign(numLocVisits, NO_INTERACTION);
+    lastInteraction.resize(numLocVisits);
+  }
   for (const Event &event : loc->events) {
     #if ENABLE_DEBUG >= DEBUG_VERBOSE
-    if (ARRIVAL == event.type) {
+    if (ARRIVAL == event.getType()) {
       numPresent++;
     } else {
       numPresent--;
@@ -261,20 +437,21 @@ Counter Locations::processEvents(Location *loc) {
       continue;
     }
 
-    if (ARRIVAL == event.type) {
+    if (ARRIVAL == event.getType()) {
       arrivals->push_back(event);
-      std::push_heap(arrivals->begin(), arrivals->end(), Event::greaterPartner);
+      std::push_heap(arrivals->begin(), arrivals->end(), greaterPartner);
 
-    } else if (DEPARTURE == event.type) {
+    } else if (DEPARTURE == event.getType()) {
       // Remove the arrival event corresponding to this departure
-      std::pop_heap(arrivals->begin(), arrivals->end(), Event::greaterPartner);
+      std::pop_heap(arrivals->begin(), arrivals->end(), greaterPartner);
       arrivals->pop_back();
 
       onDeparture(loc, event);
     }
   }
-  loc->events.clear();
-  interactions.clear();
+  loc->clearVisits();
+  interactionArena.clear();
+  nextInteraction.clear();
 
   #if ENABLE_DEBUG >= DEBUG_VERBOSE
   double p = contactModel->getContactProbability(*loc);
@@ -301,9 +478,10 @@ Counter Locations::saveInteractions(const Location &loc,
   Counter count = 0;
   for (const Event &a : susceptibleArrivals) {
     if (NULL != out) {
-      *out << loc.getUniqueId() << "," << departure.personIdx << ","
-      << departure.partnerTime << ","  << departure.scheduledTime << ","
-      << a.personIdx << "," << a.scheduledTime << "," << a.partnerTime
+      *out << loc.getUniqueId() << "," << loc.visitors[departure.visitIdx]
+      << "," << departure.partnerTime << ","  << departure.getTime() << ","
+      << loc.visitors[a.visitIdx] << "," << a.getTime() << ","
+      << a.partnerTime
       << std::endl;
     }
     if (Event::overlap(a, departure)) {
@@ -312,9 +490,10 @@ Counter Locations::saveInteractions(const Location &loc,
   }
   for (const Event &a : infectiousArrivals) {
     if (NULL != out) {
-      *out << loc.getUniqueId() << "," << departure.personIdx << ","
-      << departure.partnerTime << ","  << departure.scheduledTime << ","
-      << a.personIdx << "," << a.scheduledTime << "," << a.partnerTime
+      *out << loc.getUniqueId() << "," << loc.visitors[departure.visitIdx]
+      << "," << departure.partnerTime << ","  << departure.getTime() << ","
+      << loc.visitors[a.visitIdx] << "," << a.getTime() << ","
+      << a.partnerTime
       << std::endl;
     }
     if (Event::overlap(a, departure)) {
@@ -342,12 +521,12 @@ void Locations::onSusceptibleDeparture(Location *loc,
   for (const Event &infectiousArrival : infectiousArrivals) {
     registerInteraction(loc, susceptibleDeparture, infectiousArrival,
       // The start time is whichever arrival happened later
-      std::max(infectiousArrival.scheduledTime,
+      std::max(infectiousArrival.getTime(),
         susceptibleDeparture.partnerTime),
-      susceptibleDeparture.scheduledTime);
+      susceptibleDeparture.getTime());
   }
 
-  sendInteractions(loc, susceptibleDeparture.personIdx);
+  sendInteractions(loc, susceptibleDeparture.visitIdx);
 }
 
 void Locations::onInfectiousDeparture(Location *loc,
@@ -357,9 +536,9 @@ void Locations::onInfectiousDeparture(Location *loc,
   for (const Event &susceptibleArrival : susceptibleArrivals) {
     registerInteraction(loc, susceptibleArrival, infectiousDeparture,
       // The start time is whichever arrival happened later
-      std::max(susceptibleArrival.scheduledTime,
+      std::max(susceptibleArrival.getTime(),
         infectiousDeparture.partnerTime),
-      infectiousDeparture.scheduledTime);
+      infectiousDeparture.getTime());
   }
 }
 
@@ -372,46 +551,88 @@ inline void Locations::registerInteraction(Location *loc,
 
   double propensity = diseaseModel->getPropensity(susceptibleEvent.personState,
     infectiousEvent.personState, startTime, endTime,
-    susceptibleEvent.transmissionModifier, infectiousEvent.transmissionModifier);
+    loc->transmissionModifiers[susceptibleEvent.visitIdx],
+    loc->transmissionModifiers[infectiousEvent.visitIdx]);
+
+  Interaction inter(propensity,
+    static_cast<int>(loc->visitors[infectiousEvent.visitIdx]),
+    infectiousEvent.personState, startTime, endTime);
+  uint32_t visitIdx = susceptibleEvent.visitIdx;
+  if (aggregateExposures) {
+    exposures[visitIdx].accumulate(inter, unitDistrib(generator));
+    return;
+  }
 
-  // Note that this will create a new vector if this is the first potential
-  // infection for the susceptible person in question
-  Interaction inter { propensity, infectiousEvent.personIdx,
-    infectiousEvent.personState, startTime, endTime };
-  interactions[susceptibleEvent.personIdx].emplace_back(inter);
+  // Add this to the end of the visit's chain
+  uint32_t interactionIdx = static_cast<uint32_t>(interactionArena.size());
+  interactionArena.push_back(inter);
+  nextInteraction.push_back(NO_INTERACTION);
+  if (NO_INTERACTION == firstInteraction[visitIdx]) {
+    firstInteraction[visitIdx] = interactionIdx;
+  } else {
+    nextInteraction[lastInteraction[visitIdx]] = interactionIdx;
+  }
+  lastInteraction[visitIdx] = interactionIdx;
 }
 
-// Simple helper function which send the list of interactions with the
-// specified person to the appropriate People chare
+// Simple helper function which queues up the list of interactions with the
+// specified person for the appropriate People chare
 inline void Locations::sendInteractions(Location *loc,
-    Id personIdx) {
-  PartitionId peoplePartitionIdx = getPartitionIndex(personIdx,
-    numPeople, numPeoplePartitions, firstPersonIdx);
+    uint32_t visitIdx) {
+  PartitionId peoplePartitionIdx;
+  uint32_t personOffset;
+  getPartitionSlot(loc->visitors[visitIdx], numPeoplePerPartition,
+    numPeoplePartitions, firstPersonIdx, &peoplePartitionIdx, &personOffset);
+
+  InteractionBatch &batch = outgoingInteractions[peoplePartitionIdx];
+  size_t numQueued = batch.interactions.size();
+  if (aggregateExposures) {
+    if (0.0 < exposures[visitIdx].propensity) {
+      batch.interactions.push_back(exposures[visitIdx]);
+    }
+  } else {
+    for (uint32_t i = firstInteraction[visitIdx]; NO_INTERACTION != i;
+        i = nextInteraction[i]) {
+      batch.interactions.push_back(interactionArena[i]);
+    }
+  }
+  // Nothing to send if no one infectious was there during the visit
+  if (batch.interactions.size() == numQueued) {
+    return;
+  }
 
-  InteractionMessage interMsg(loc->getUniqueId(), personIdx,
-      interactions[personIdx]);
   #ifdef USE_HYPERCOMM
   Aggregator* agg = aggregatorProxy.ckLocalBranch();
   if (agg->interact_aggregator) {
+    InteractionMessage interMsg(personOffset, std::vector<Interaction>(
+          batch.interactions.begin() + numQueued, batch.interactions.end()));
+    batch.interactions.resize(numQueued);
     agg->interact_aggregator->send(peopleArray[peoplePartitionIdx], interMsg);
-  } else {
-  #endif  // USE_HYPERCOMM
-    peopleArray[peoplePartitionIdx].ReceiveInteractions(interMsg);
-  #ifdef USE_HYPERCOMM
+    return;
   }
   #endif  // USE_HYPERCOMM
+  batch.personOffsets.push_back(personOffset);
+  batch.counts.push_back(
+      static_cast<uint32_t>(batch.interactions.size() - numQueued));
+}
 
-  // CkPrintf(
-  //   "    Sending %d interactions to person %d in partition %d\r\n",
-  //   (int) interactions[personIdx].size(),
-  //   personIdx,
-  //   peoplePartitionIdx
-  // );
-
-  // Free up space where we were storing interactions data. This also prevents
-  // interactions from being sent multiple times if this person has multiple
-  // visits to this location
-  interactions.erase(personIdx);
+void Locations::sendInteractionBatches() {
+  for (PartitionId p = 0; p < numPeoplePartitions; ++p) {
+    InteractionBatch &batch = outgoingInteractions[p];
+    if (batch.personOffsets.empty()) {
+      continue;
+    }
+
+    peopleArray[p].ReceiveInteractionBatch(
+        static_cast<int>(batch.personOffsets.size()),
+        batch.personOffsets.data(), batch.counts.data(),
+        static_cast<int>(batch.interactions.size()),
+        batch.interactions.data());
+    ++sentInteractionMessages[p];
+    batch.personOffsets.clear();
+    batch.counts.clear();
+    batch.interactions.clear();
+  }
 }
 
 void Locations::ReceiveIntervention(PartitionId interventionIdx) {
@@ -12,18 +12,25 @@
 #include "DiseaseModel.h"
 #include "Location.h"
 #include "contact_model/ContactModel.h"
+#include "readers/AttributeStore.h"
 
 #include <vector>
 #include <set>
 #include <string>
 #include <unordered_map>
 #include <iostream>
+#include <cstdint>
+
+// Marks the end of a visit's chain of interactions
+#define NO_INTERACTION UINT32_MAX
 
 class Locations : public CBase_Locations {
  private:
   Id numLocalLocations;
   Id firstLocalLocationIdx;
   std::vector<Location> locations;
+  // Attributes of every location, indexed by local index
+  AttributeStore attributeStore;
   DiseaseModel *diseaseModel;
   ContactModel *contactModel;
   std::ofstream *interactionsFile;
@@ -37,10 +44,45 @@ class Locations : public CBase_Locations {
   // a person at a location
   std::vector<Event> infectiousArrivals;
   std::vector<Event> susceptibleArrivals;
+  // Scratch space for sorting each location's events
+  std::vector<Event> sortBuffer;
 
-  // Maps each susceptible person's id to a list of interactions with people
-  // who could have infected them
-  std::unordered_map<Id, std::vector<Interaction> > interactions;
+  // Interactions registered while sweeping the current location, chained
+  // together by the susceptible visit they belong to (the visit's index in
+  // the location's side arrays). These are only cleared, never freed, so
+  // once they've grown to fit the busiest location registering an
+  // interaction doesn't allocate
+  std::vector<Interaction> interactionArena;
+  std::vector<uint32_t> nextInteraction;
+  std::vector<uint32_t> firstInteraction;
+  std::vector<uint32_t> lastInteraction;
+  // When aggregating exposures, each susceptible visit's interactions are
+  // instead folded into just one of them (see Interaction::accumulate)
+  std::vector<Interaction> exposures;
+  // Interactions for each People chare, gathered over all of our locations
+  // and sent as one batch. Recipient i gets counts[i] interactions, which
+  // follow those of the recipients before it
+  struct InteractionBatch {
+    std::vector<uint32_t> personOffsets;
+    std::vector<uint32_t> counts;
+    std::vector<Interaction> interactions;
+  };
+  std::vector<InteractionBatch> outgoingInteractions;
+  // With resident visits, each person who visits any of our locations gets
+  // a slot holding the latest state, transmission modifier and visit
+  // filters they've sent us, which their stored visits refer to
+  std::unordered_map<uint32_t, uint32_t> visitorSlots;
+  std::vector<DiseaseState> slotStates;
+  std::vector<double> slotModifiers;
+  std::vector<FilterMask> slotFilters;
+  // With counted phases, how many visit messages have arrived this round,
+  // how many are coming (or -1 until we've been told), and how many
+  // interaction messages we've sent each People chare today. Days with
+  // infectious visits sent first have two rounds of visits
+  int receivedVisitMessages;
+  int expectedVisitMessages;
+  bool sentHotWindows;
+  std::vector<int> sentInteractionMessages;
 
   // Runs through all of the current events and return the indices of
   // any people who have been infected
@@ -58,9 +100,22 @@ class Locations : public CBase_Locations {
   inline void registerInteraction(Location *loc, const Event &susceptibleEvent,
     const Event &infectiousEvent, Time startTime, Time endTime);
 
-  // Simple helper function which send the list of interactions with the
-  // specified person to the appropriate People chare
-  inline void sendInteractions(Location *loc, Id personIdx);
+  inline void receiveVisit(const VisitMessage &visitMsg);
+  // Returns the slot of the person at this offset, adding one if needed
+  uint32_t getVisitorSlot(uint32_t personOffset);
+  // Sorts a location's visits for one day of the schedule and keeps them
+  void storeResidentDay(Location *loc, int scheduleDay);
+  // Queues up a location's stored visits for one day of the schedule, less
+  // any which have been filtered out
+  void loadResidentDay(Location *loc, int scheduleDay);
+
+  // Simple helper function which queues up the list of interactions with
+  // the specified person for the appropriate People chare
+  inline void sendInteractions(Location *loc, uint32_t visitIdx);
+  void sendInteractionBatches();
+  // Moves on to the next phase once every visit message has arrived
+  void countVisitMessage();
+  void checkVisitsComplete();
 
   #if ENABLE_DEBUG >= DEBUG_VERBOSE
   Counter saveInteractions(const Location &loc, const Event &departure,
@@ -72,6 +127,19 @@ class Locations : public CBase_Locations {
   explicit Locations(CkMigrateMessage *msg);
   void pup(PUP::er &p);  // NOLINT(runtime/references)
   void ReceiveVisitMessages(VisitMessage visitMsg);
+  // Each People chare sends all of its visits to a chare at once, with
+  // zero copy for large batches
+  void ReceiveVisitBatch(int numVisits, VisitMessage *visits);
+  // When sending infectious visits first, tells every People chare when
+  // someone infectious was at each of our locations
+  void SendHotWindows();
+  // With counted phases, the number of visit messages every People chare
+  // sent to each Locations chare this round
+  void ExpectVisitMessages(CkReductionMsg *msg);
+  void ReceiveLargeVisitBatch(int numVisits, VisitMessage *visits);
+  // With resident visits, each People chare sends the changes to its
+  // visitors' states rather than visits after the first week
+  void ReceiveVisitorUpdates(int numUpdates, VisitorUpdate *updates);
   void ComputeInteractions();  // calls ReceiveInfections
   void ReceiveIntervention(PartitionId interventionIdx);
   // Load location data from CSV.
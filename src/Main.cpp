@@ -12,11 +12,14 @@
 #include "DiseaseModel.h"
 #include "contact_model/ContactModel.h"
 #include "readers/Preprocess.h"
+#include "readers/PopulationReader.h"
+#include "readers/BinaryFormat.h"
 
 #include <string>
 #include <tuple>
 #include <iostream>
 #include <fstream>
+#include <cstdio>
 #include <cstdlib>
 #include <sstream>
 #include <limits>
@@ -44,6 +47,7 @@
 /* readonly */ CProxy_Aggregator aggregatorProxy;
 #endif
 /* readonly */ CProxy_DiseaseModel globDiseaseModel;
+/* readonly */ CProxy_PopulationReader globPopulationReader;
 /* readonly */ CProxy_TraceSwitcher traceArray;
 /* readonly */ int numPeople;
 /* readonly */ int numLocations;
@@ -53,7 +57,13 @@
 /* readonly */ int numLocationsPerPartition;
 /* readonly */ int numDays;
 /* readonly */ int numDaysWithDistinctVisits;
+/* readonly */ int visitWindow;
+/* readonly */ bool aggregateExposures;
+/* readonly */ bool infectiousFirst;
+/* readonly */ bool residentVisits;
+/* readonly */ bool countedPhases;
 /* readonly */ bool syntheticRun;
+/* readonly */ bool binaryInput;
 /* readonly */ int contactModelType;
 /* readonly */ int maxSimVisitsIdx;
 /* readonly */ int ageIdx;
@@ -228,28 +238,25 @@ Main::Main(CkArgMsg* msg) {
   CkPrintf("Reading disease model from %s\n", msg->argv[argNum]);
 #endif
 
-  // Handle both real data runs or runs using synthetic populations.
-  std::string scenarioPath;
-  std::string scenarioId;
-  if (syntheticRun) {
-    firstPersonIdx = 0;
-    firstLocationIdx = 0;
-  } else {
-    // Create data caches.
+  if (!syntheticRun) {
     scenarioPath = std::string(msg->argv[++argNum]);
     // This allows users to omit the trailing "/" from the scenario path
     // while still allowing us to find the files properly
     if (scenarioPath.back() != '/') {
       scenarioPath.push_back('/');
     }
-    std::tie(firstPersonIdx, firstLocationIdx, scenarioId) = buildCache(
-        scenarioPath, numPeople, numPeoplePartitions, numLocations,
-        numLocationPartitions, numDaysWithDistinctVisits);
   }
 
   // Detemine which contact modle to use
   contactModelType = static_cast<int>(ContactModelType::constant_probability);
   interventionStategy = false;
+  binaryInput = false;
+  buildingIndex = false;
+  visitWindow = 0;
+  aggregateExposures = false;
+  infectiousFirst = false;
+  residentVisits = false;
+  countedPhases = false;
   int interventionStategyLocation = -1;
   for (; argNum < msg->argc; ++argNum) {
     std::string tmp = std::string(msg->argv[argNum]);
@@ -263,6 +270,94 @@ Main::Main(CkArgMsg* msg) {
     } else if ("-i" == tmp && argNum + 1 < msg->argc) {
       interventionStategyLocation = ++argNum;
       interventionStategy = true;
+
+    } else if ("-b" == tmp || "--binary" == tmp) {
+      binaryInput = true;
+
+    } else if (("-w" == tmp || "--visit-window" == tmp)
+        && argNum + 1 < msg->argc) {
+      visitWindow = atoi(msg->argv[++argNum]);
+      if (0 >= visitWindow) {
+        CkAbort("Error: visit window must be at least one day\n");
+      }
+
+    } else if ("-e" == tmp || "--aggregate-exposures" == tmp) {
+      aggregateExposures = true;
+
+    } else if ("-f" == tmp || "--infectious-first" == tmp) {
+      infectiousFirst = true;
+
+    } else if ("-r" == tmp || "--resident-visits" == tmp) {
+      residentVisits = true;
+
+    } else if ("-c" == tmp || "--counted-phases" == tmp) {
+      countedPhases = true;
+    }
+  }
+
+  // Visits are only streamed in from the csvs, and there's nothing to gain
+  // if the whole schedule fits in the window anyway
+  if (0 < visitWindow && (syntheticRun || binaryInput)) {
+    CkAbort("Error: visit windows can only be used with csv input\n");
+  } else if (numDaysWithDistinctVisits <= visitWindow) {
+    visitWindow = 0;
+  }
+  // Resident visits need each person's whole schedule up front, and every
+  // one of their visits
+  if (residentVisits && (0 < visitWindow || infectiousFirst)) {
+    CkAbort("Error: resident visits can't be combined with visit windows "
+        "or sending infectious visits first\n");
+  }
+#ifdef USE_HYPERCOMM
+  // Aggregated messages can't be counted until they're flushed
+  if (countedPhases) {
+    CkAbort("Error: counted phases can't be used with Hypercomm\n");
+  }
+#endif  // USE_HYPERCOMM
+#if ENABLE_DEBUG >= DEBUG_BASIC
+  if (0 < visitWindow) {
+    CkPrintf("Keeping %d of %d days of visits in memory\n", visitWindow,
+        numDaysWithDistinctVisits);
+  }
+  if (aggregateExposures) {
+    CkPrintf("Sending one aggregated exposure per susceptible visit\n");
+  }
+  if (infectiousFirst) {
+    CkPrintf("Only sending susceptible visits which overlap infectious ones\n");
+  }
+  if (residentVisits) {
+    CkPrintf("Keeping visits at locations after the first %d days\n",
+        numDaysWithDistinctVisits);
+  }
+  if (countedPhases) {
+    CkPrintf("Ending phases by counting messages rather than quiescence\n");
+  }
+#endif
+
+  // Handle both real data runs or runs using synthetic populations.
+  if (syntheticRun) {
+    firstPersonIdx = 0;
+    firstLocationIdx = 0;
+  } else if (binaryInput) {
+    // Convert the scenario to binary the first time it's used...
+    std::tie(firstPersonIdx, firstLocationIdx) = buildBinaryCache(
+        scenarioPath, numPeople, numLocations);
+  } else {
+    // ...or else check for an index of the csvs. The first ids are needed up
+    // front, but building the index is left to all of the PEs
+    indexFingerprint = getScenarioFingerprint(scenarioPath);
+    indexPath = getIndexPath(scenarioPath, getScenarioId(numPeople,
+          numLocations, numDaysWithDistinctVisits));
+    IndexHeader header;
+    if (isValidIndex(indexPath, indexFingerprint, &header)) {
+      CkPrintf("Using existing index %s\n", indexPath.c_str());
+      firstPersonIdx = header.firstPersonIdx;
+      firstLocationIdx = header.firstLocationIdx;
+    } else {
+      std::tie(firstPersonIdx, firstLocationIdx) =
+        getFirstIndices(scenarioPath);
+      std::remove((indexPath + INDEX_TMP_SUFFIX).c_str());
+      buildingIndex = true;
     }
   }
 
@@ -350,9 +445,28 @@ Main::Main(CkArgMsg* msg) {
   seed = 0;
 #endif
 
-  peopleArray = CProxy_People::ckNew(seed, scenarioPath, numPeoplePartitions);
-  locationsArray = CProxy_Locations::ckNew(seed, scenarioPath,
-      numLocationPartitions);
+  if (!syntheticRun && !binaryInput) {
+    // One reader per node does all of the csv I/O for its chares
+    globPopulationReader = CProxy_PopulationReader::ckNew(scenarioPath);
+
+    // The arrays have to exist before the readonlies are sent out, but
+    // their elements can't load any data until the index is done. The
+    // elements are placed explicitly so the readers know which are local
+    peopleArray = CProxy_People::ckNew();
+    locationsArray = CProxy_Locations::ckNew();
+    if (buildingIndex) {
+      CkPrintf("Building index %s on %d PEs\n", indexPath.c_str(),
+          CkNumPes());
+      CProxy_Preprocessor::ckNew(scenarioPath, indexFingerprint);
+    } else {
+      InsertChares();
+    }
+
+  } else {
+    peopleArray = CProxy_People::ckNew(seed, scenarioPath, numPeoplePartitions);
+    locationsArray = CProxy_Locations::ckNew(seed, scenarioPath,
+        numLocationPartitions);
+  }
 
 #ifdef ENABLE_TRACING
   traceArray = CProxy_TraceSwitcher::ckNew();
@@ -408,6 +522,27 @@ Main::Main(CkArgMsg* msg) {
 #endif  // USE_HYPERCOMM
 }
 
+void Main::IndexBuilt() {
+  finishIndex(indexPath);
+  CkPrintf("Finished building index in %lf seconds.\n",
+      CkWallTimer() - dataLoadingStartTime);
+  dataLoadingStartTime = CkWallTimer();
+  InsertChares();
+}
+
+void Main::InsertChares() {
+  for (int i = 0; i < numPeoplePartitions; ++i) {
+    peopleArray[i].insert(seed, scenarioPath,
+        getPartitionPe(i, numPeoplePartitions));
+  }
+  peopleArray.doneInserting();
+  for (int i = 0; i < numLocationPartitions; ++i) {
+    locationsArray[i].insert(seed, scenarioPath,
+        getPartitionPe(i, numLocationPartitions));
+  }
+  locationsArray.doneInserting();
+}
+
 void Main::CharesCreated() {
   // CkPrintf("  %d of %d chares created\n", createdCount, chareCount);
   if (++createdCount == chareCount) {
@@ -419,29 +554,12 @@ void Main::CharesCreated() {
 }
 
 void Main::SeedInfections() {
-  std::default_random_engine generator(seed);
-
   // Determine all of the intitial infections on the first day so we can
   // guarentee they are unique (not checking this quickly runs into birthday
   // problem issues, even for sizable datasets)
   if (0 == day) {
-    std::uniform_int_distribution<Id> personDistrib(firstPersonIdx,
-        firstPersonIdx + numPeople - 1);
-    std::unordered_set<Id> initialInfectionsSet;
-    initialInfections.reserve(INITIAL_INFECTIONS);
-    // Use set to check membership becuase it's faster and we can spare the
-    // memory; INITIAL_INFECTIONS should be fairly small
-    initialInfectionsSet.reserve(INITIAL_INFECTIONS);
-    while (initialInfectionsSet.size() < INITIAL_INFECTIONS
-        // This loop will go forever on small test populations without
-        // this check
-        && initialInfectionsSet.size() < numPeople) {
-      Id personIdx = personDistrib(generator);
-      if (initialInfectionsSet.count(personIdx) == 0) {
-        initialInfections.emplace_back(personIdx);
-        initialInfectionsSet.emplace(personIdx);
-      }
-    }
+    initialInfections = getInitialInfections(seed, numPeople,
+        firstPersonIdx);
   }
 
   // Check for empty is to avoid issues with small test populations
@@ -450,18 +568,17 @@ void Main::SeedInfections() {
     Id personIdx = initialInfections.back();
     initialInfections.pop_back();
 
-    int peoplePartitionIdx = getPartitionIndex(
-      personIdx,
-      numPeople,
-      numPeoplePartitions,
-      firstPersonIdx);
+    PartitionId peoplePartitionIdx;
+    uint32_t personOffset;
+    getPartitionSlot(personIdx, numPeoplePerPartition, numPeoplePartitions,
+      firstPersonIdx, &peoplePartitionIdx, &personOffset);
 
     // Make a super contagious visit for that person.
     std::vector<Interaction> interactions;
     interactions.emplace_back(
       std::numeric_limits<double>::max(), 0, 0, 0, std::numeric_limits<int>::max());
 
-    InteractionMessage interMsg(-1, personIdx, interactions);
+    InteractionMessage interMsg(personOffset, interactions);
     #ifdef USE_HYPERCOMM
     Aggregator* agg = aggregatorProxy.ckLocalBranch();
     if (agg->interact_aggregator) {
@@ -9,6 +9,7 @@
 
 #include "charm++.h"
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <memory>
@@ -19,13 +20,19 @@ class Main : public CBase_Main {
   int seed;
   std::string pathToOutput;
   std::vector<int> accumulated;
-  std::vector<int> initialInfections;
+  std::vector<Id> initialInfections;
   DiseaseModel* diseaseModel;
   int chareCount;
   int createdCount;
+  std::string scenarioPath;
+  std::string indexPath;
+  uint64_t indexFingerprint;
+  bool buildingIndex;
 
  public:
   explicit Main(CkArgMsg* msg);
+  void IndexBuilt();
+  void InsertChares();
   void CharesCreated();
   void SeedInfections();
   void SaveStats(Id *data);
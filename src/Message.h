@@ -8,50 +8,90 @@
 #define MESSAGE_H_
 
 #include "Types.h"
+#include "Defs.h"
 #include "Interaction.h"
 #include "pup_stl.h"
 
+#include <cstdint>
 #include <vector>
-#include <functional>
+
+// Senders resolve which chare each message goes to and the index of its
+// person or location there as 32-bit offsets, so receivers can use them
+// directly. Along with dropping the filter pointer, this takes visits from
+// 40 to 32 bytes (26 bytes of fields plus padding). Times and anything
+// which feeds into propensities are still sent at full precision
 
 struct VisitMessage {
-  Id locationIdx;
-  Id personIdx;
-  DiseaseState personState;
-  Time visitStart;
-  Time visitEnd;
   // Susceptibility or infectivity, depending on disease state
   double transmissionModifier;
-  const void *deactivatedBy;
+  // Index of the location on its Locations chare
+  uint32_t locationOffset;
+  // Relative to firstPersonIdx
+  uint32_t personOffset;
+  Time visitStart;
+  Time visitEnd;
+  DiseaseState personState;
 
   VisitMessage() {}
   explicit VisitMessage(CkMigrateMessage *msg) {}
-  VisitMessage(Id locationIdx_, Id personIdx_, DiseaseState personState_,
-      Time visitStart_, Time visitEnd_, double transmissionModifier_) :
-    locationIdx(locationIdx_), personIdx(personIdx_),
-    personState(personState_), visitStart(visitStart_),
-    visitEnd(visitEnd_), transmissionModifier(transmissionModifier_),
-    deactivatedBy(NULL) {}
+  VisitMessage(uint32_t locationOffset_, uint32_t personOffset_,
+      DiseaseState personState_, Time visitStart_, Time visitEnd_,
+      double transmissionModifier_) :
+    transmissionModifier(transmissionModifier_),
+    locationOffset(locationOffset_), personOffset(personOffset_),
+    visitStart(visitStart_), visitEnd(visitEnd_), personState(personState_)
+    {}
 };
 PUPbytes(VisitMessage);
 
-using VisitTest = std::function<bool(const VisitMessage &)>;
+// A change to a person's state, transmission modifier or visit filters,
+// sent to every Locations chare holding their resident visits
+struct VisitorUpdate {
+  double transmissionModifier;
+  // Relative to firstPersonIdx
+  uint32_t personOffset;
+  FilterMask visitFilters;
+  DiseaseState personState;
+
+  VisitorUpdate() {}
+  VisitorUpdate(uint32_t personOffset_, DiseaseState personState_,
+      double transmissionModifier_, FilterMask visitFilters_) :
+    transmissionModifier(transmissionModifier_), personOffset(personOffset_),
+    visitFilters(visitFilters_), personState(personState_) {}
+};
+PUPbytes(VisitorUpdate);
+
+// A span of time during which someone infectious was at a location
+struct HotWindow {
+  // Relative to firstLocationIdx
+  uint32_t locationOffset;
+  Time start;
+  Time end;
+
+  HotWindow() {}
+  HotWindow(uint32_t locationOffset_, Time start_, Time end_) :
+    locationOffset(locationOffset_), start(start_), end(end_) {}
+
+  bool operator<(const HotWindow &other) const {
+    return locationOffset < other.locationOffset
+      || (locationOffset == other.locationOffset && start < other.start);
+  }
+};
+PUPbytes(HotWindow);
 
 struct InteractionMessage {
-  Id locationIdx;
-  Id personIdx;
+  // Index of the person on its People chare
+  uint32_t personOffset;
   std::vector<Interaction> interactions;
 
   InteractionMessage() {}
   explicit InteractionMessage(CkMigrateMessage *msg) {}
-  InteractionMessage(Id locationIdx_, Id personIdx_,
+  InteractionMessage(uint32_t personOffset_,
       const std::vector<Interaction>& interactions_)
-    : locationIdx(locationIdx_), personIdx(personIdx_),
-    interactions(interactions_) {}
+    : personOffset(personOffset_), interactions(interactions_) {}
 
   void pup(PUP::er& p) {  // NOLINT(runtime/references)
-    p | locationIdx;
-    p | personIdx;
+    p | personOffset;
     p | interactions;
   }
 };
@@ -12,8 +12,12 @@
 #include "Interaction.h"
 #include "DiseaseModel.h"
 #include "Person.h"
+#include "VisitSchedule.h"
 #include "readers/Preprocess.h"
 #include "readers/DataReader.h"
+#include "readers/BinaryFormat.h"
+#include "readers/LineReader.h"
+#include "readers/PopulationReader.h"
 #include "intervention_model/Intervention.h"
 
 #ifdef USE_HYPERCOMM
@@ -35,7 +39,8 @@ std::uniform_real_distribution<> unitDistrib(0, 1);
 #define ONE_ATTR 1
 #define DEFAULT_
 
-People::People(int seed, std::string scenarioPath) {
+People::People(int seed, std::string scenarioPath_) :
+    scenarioPath(scenarioPath_) {
   // Must be set to true to make AtSync work
   usesAtSync = true;
 
@@ -62,12 +67,35 @@ People::People(int seed, std::string scenarioPath) {
   double startTime = CkWallTimer();
 #endif
 
+  // When visits are streamed in, each day only needs to be kept until it's
+  // been sent, so its slot can be reused for a later day
+  int numResidentDays = 0 < visitWindow ? visitWindow
+    : numDaysWithDistinctVisits;
   int numInterventions = diseaseModel->getNumPersonInterventions();
+  attributeStore = AttributeStore(diseaseModel->personAttributes,
+      numLocalPeople, numInterventions);
   people.reserve(numLocalPeople);
   for (Id i = 0; i < numLocalPeople; i++) {
-    people.emplace_back(diseaseModel->personAttributes,
-        numInterventions, 0, std::numeric_limits<Time>::max(),
-        numDaysWithDistinctVisits);
+    people.emplace_back(&attributeStore, i);
+  }
+  schedule = VisitSchedule(numLocalPeople, numResidentDays);
+  states.resize(numLocalPeople, 0);
+  nextStates.resize(numLocalPeople, -1);
+  secondsLeftInState.resize(numLocalPeople, std::numeric_limits<Time>::max());
+  if (aggregateExposures) {
+    exposures.resize(numLocalPeople, Interaction(0.0, -1, -1, 0, 0));
+  } else {
+    interactions.resize(numLocalPeople);
+  }
+  outgoingVisits.resize(numLocationPartitions);
+  if (residentVisits) {
+    outgoingUpdates.resize(numLocationPartitions);
+  }
+  sentVisitMessages.resize(numLocationPartitions, 0);
+  receivedInteractionMessages = 0;
+  expectedInteractionMessages = -1;
+  if (countedPhases) {
+    findSeedOffsets(seed);
   }
 
   if (syntheticRun) {
@@ -85,6 +113,10 @@ for (Person &p : people) {
   }
 }
 
+  if (residentVisits) {
+    setUpResidentVisits();
+  }
+
 #if ENABLE_DEBUG >= DEBUG_PER_CHARE
   CkPrintf("  Chare %d took %f s to load people\n", thisIndex,
       CkWallTimer() - startTime);
@@ -99,21 +131,23 @@ People::People(CkMigrateMessage *msg) {}
 void People::generatePeopleData(Id firstLocalPersonIdx) {
   // Init peoples ids and randomly init ages.
   std::uniform_int_distribution<int> age_dist(0, 100);
-  int ageIndex = diseaseModel->personAttributes.getAttributeIndex("age");
+  int ageIndex = diseaseModel->personAttributes.getAttributeIndex(
+      AGE_ATTRIBUTE);
   for (Id i = 0; i < numLocalPeople; i++) {
     Person &p = people[i];
 
-    std::vector<union Data> data = p.getData();
     if (-1 != ageIndex) {
-      data[ageIndex].int32_val = age_dist(generator);
+      union Data age;
+      age.int32_val = age_dist(generator);
+      p.setValue(ageIndex, age);
     }
 
       p.setUniqueId(firstLocalPersonIdx + i);
-      p.state = diseaseModel->getHealthyState(data);
+      states[i] = diseaseModel->getHealthyState(p);
 
     // We set persons next state to equal current state to signify
     // that they are not in a disease model progression.
-    p.next_state = p.state;
+    nextStates[i] = states[i];
   }
 }
 
@@ -160,16 +194,15 @@ void People::generateVisitData() {
     numLocations, numLocationPartitions, homePartitionIdx);
 
   // Calculate schedule for each person.
-  for (Person &p : people) {
-    Id personIdx = p.getUniqueId();
+  for (Id i = 0; i < numLocalPeople; ++i) {
+    Id personIdx = people[i].getUniqueId();
 
     // Calculate home location
     Id localPersonIdx = (personIdx - firstLocationIdx) % homePartitionNumLocations;
     int homeX = homePartitionStartX + localPersonIdx % locationPartitionWidth;
     int homeY = homePartitionStartY + localPersonIdx / locationPartitionWidth;
 
-    p.visitsByDay.resize(numDaysWithDistinctVisits);
-    for (std::vector<VisitMessage> &visits : p.visitsByDay) {
+    for (int d = 0; d < numDaysWithDistinctVisits; ++d) {
       // Get random number of visits for this person.
       int numVisits = num_visits_generator(generator);
       // Randomly generate start and end times for each visit,
@@ -241,8 +274,8 @@ void People::generateVisitData() {
           + partitionX * numLocationsPerPartition
           + partitionY * locationPartitionGridWidth * numLocationsPerPartition;
 
-        visits.emplace_back(destinationIdx, personIdx, 0, visitStart,
-            visitEnd, 0);
+        schedule.addVisit(d, i, destinationIdx, visitStart,
+            visitEnd - visitStart);
 
   #if ENABLE_DEBUG >= DEBUG_PER_OBJECT
         CkPrintf(
@@ -255,127 +288,216 @@ void People::generateVisitData() {
       }
     }
   }
+  for (int d = 0; d < numDaysWithDistinctVisits; ++d) {
+    schedule.finishDay(d);
+  }
 }
 
 /**
  * Loads real people data from file.
  */
 void People::loadPeopleData(std::string scenarioPath) {
-  std::string scenarioId = getScenarioId(numPeople, numPeoplePartitions,
-    numLocations, numLocationPartitions);
-  std::ifstream peopleData(scenarioPath + "people.csv");
-  std::ifstream peopleCache(scenarioPath + scenarioId + "_people.cache",
-    std::ios_base::binary);
-  if (!peopleData || !peopleCache) {
-    CkAbort("Could not open person data input.");
-  }
-
-  // Find starting line for our data through people cache.
-  peopleCache.seekg(thisIndex * sizeof(CacheOffset));
-  CacheOffset peopleOffset;
-  peopleCache.read(reinterpret_cast<char *>(&peopleOffset), sizeof(CacheOffset));
-  peopleData.seekg(peopleOffset);
-
-  // Read in from remote file.
-  DataReader<Person>::readData(&peopleData, diseaseModel->personDef, &people);
-  peopleData.close();
-  peopleCache.close();
-
-  // Open activity data and cache.
-  std::ifstream activityData(scenarioPath + "visits.csv");
-  std::ifstream activityCache(scenarioPath + scenarioId
-      + "_visits.cache", std::ios_base::binary);
-  if (!activityData || !activityCache) {
-    CkAbort("Could not open activity input.");
-  }
-
-  // Load preprocessing meta data.
-  CacheOffset *buf = reinterpret_cast<CacheOffset *>(
-    malloc(sizeof(CacheOffset) * numDaysWithDistinctVisits));
-  for (Id c = 0; c < numLocalPeople; c++) {
-    std::vector<CacheOffset> *data_pos = &people[c].visitOffsetByDay;
-    Id curr_id = people[c].getUniqueId();
-
-    // Read in their activity data offsets.
-    activityCache.seekg(sizeof(CacheOffset) * numDaysWithDistinctVisits
-       * (curr_id - firstPersonIdx));
-    activityCache.read(reinterpret_cast<char *>(buf),
-      sizeof(CacheOffset) * numDaysWithDistinctVisits);
-    for (int day = 0; day < numDaysWithDistinctVisits; day++) {
-      data_pos->push_back(buf[day]);
-    }
-  }
-  free(buf);
-
-  for (Person &person : people) {
-    person.state = diseaseModel->getHealthyState(person.getData());
+  if (binaryInput) {
+    // Each chare only maps the rows it actually owns
+    Id firstLocalRow = getFirstIndex(thisIndex, numPeople,
+        numPeoplePartitions, 0);
+    BinaryReader peopleData(scenarioPath + "people" + BINARY_FILE_SUFFIX);
+    DataReader<Person>::readBinaryData(&peopleData, firstLocalRow,
+        diseaseModel->personAttributes, &attributeStore, &people);
+
+    BinaryReader activityData(scenarioPath + "visits" + BINARY_FILE_SUFFIX);
+    loadBinaryVisitData(&activityData);
+
+  } else {
+    loadCsvPeopleData(scenarioPath);
+  }
+
+  for (Id i = 0; i < numLocalPeople; ++i) {
+    states[i] = diseaseModel->getHealthyState(people[i]);
     // TODO(jkitson): set compliance levels based on personInterventions
   }
+}
 
-  loadVisitData(&activityData);
+void People::loadCsvPeopleData(std::string scenarioPath) {
+  // Our node's reader does the actual I/O, so we only parse our own lines
+  PopulationReader *reader = globPopulationReader.ckLocalBranch();
+  LineReader peopleReader = reader->getPeopleReader(thisIndex);
+  DataReader<Person>::readData(&peopleReader, *diseaseModel->personPlan,
+      &people);
+  reader->releasePeople();
+
+  if (0 < visitWindow) {
+    // Only the first few days are loaded now; the rest are read as the
+    // simulation reaches them
+    reader->getFirstVisitOffsets(thisIndex, &firstVisitOffsets);
+    #if ENABLE_DEBUG >= DEBUG_VERBOSE
+      int numVisits = 0;
+    #endif
+    for (int d = 0; d < visitWindow; ++d) {
+      loadVisitDay(d);
+      #if ENABLE_DEBUG >= DEBUG_VERBOSE
+        numVisits += schedule.getNumVisits(d);
+      #endif
+    }
+    #if ENABLE_DEBUG >= DEBUG_VERBOSE
+      CkCallback cb(CkReductionTarget(Main, ReceiveVisitsLoadedCount),
+          mainProxy);
+      contribute(sizeof(int), &numVisits, CkReduction::sum_int, cb);
+    #endif
+    return;
+  }
 
-  activityData.close();
+  LineReader activityReader = reader->getVisitsReader(thisIndex);
+  loadVisitData(&activityReader);
+  reader->releaseVisits();
 }
 
-void People::loadVisitData(std::ifstream *activityData) {
+void People::loadVisitData(LineReader *activityData) {
   #ifdef ENABLE_DEBUG
     int numVisits = 0;
   #endif
-  for (Person &person : people) {
-    for (int day = 0; day < numDaysWithDistinctVisits; ++day) {
-      Time nextDaySecs = (day + 1) * DAY_LENGTH;
-
-      // Seek to correct position in file.
-      CacheOffset seekPos = person
-        .visitOffsetByDay[day % numDaysWithDistinctVisits];
-      if (seekPos == EMPTY_VISIT_SCHEDULE) {
-#if ENABLE_DEBUG >= DEBUG_PER_CHARE
-        CkPrintf("  Chare %d: Person %d has no visits on day %d\n",
-            thisIndex, person.getUniqueId(), day);
-#endif
-        continue;
-      }
-
-      activityData->seekg(seekPos, std::ios_base::beg);
+  Id firstLocalPersonId = getFirstIndex(thisIndex, numPeople,
+      numPeoplePartitions, firstPersonIdx);
+  Id personId = -1;
+  Id locationId = -1;
+  Time visitStart = -1;
+  Time visitDuration = -1;
+  while (true) {
+    std::tie(personId, locationId, visitStart, visitDuration) =
+      DataReader<Person>::parseActivityStream(activityData,
+          *diseaseModel->activityPlan);
+
+    // The first visit past our last person ends our block
+    Id localIdx = personId - firstLocalPersonId;
+    if (-1 == personId || numLocalPeople <= localIdx) {
+      break;
+    } else if (0 > localIdx) {
+      CkAbort("Error: visits must be sorted by person (found person "
+          ID_PRINT_TYPE " in chare %d's block)\n", personId, thisIndex);
+    }
 
-      // Start reading
-      Id personId = -1;
-      Id locationId = -1;
-      Time visitStart = -1;
-      Time visitDuration = -1;
-      std::tie(personId, locationId, visitStart, visitDuration) =
-        DataReader<Person>::parseActivityStream(activityData,
-            diseaseModel->activityDef, NULL);
+    int day = getDay(visitStart);
+    if (numDaysWithDistinctVisits <= day) {
+      continue;
+    }
+    schedule.addVisit(day, localIdx, locationId, visitStart - day * DAY_LENGTH,
+        visitDuration);
+    #ifdef ENABLE_DEBUG
+      numVisits++;
+    #endif
 
 #if ENABLE_DEBUG >= DEBUG_PER_OBJECT
-      if (0 == personId % 10000) {
-        CkPrintf("  People chare %d, person %d reading from %u on day %d\n",
-            thisIndex, person.getUniqueId(), seekPos, day);
-        CkPrintf("  Person %d (%d) on day %d first visit: %d to %d, "
-            "at loc %d\n", person.getUniqueId(), personId, day,
-            visitStart, visitStart + visitDuration, locationId);
-      }
+    if (0 == personId % 10000) {
+      CkPrintf("  Person " ID_PRINT_TYPE " on day %d visit: %d to %d, at loc "
+          ID_PRINT_TYPE "\n",
+          personId, day, visitStart, visitStart + visitDuration, locationId);
+    }
 #endif
+  }
+  for (int d = 0; d < numDaysWithDistinctVisits; ++d) {
+    schedule.finishDay(d);
+  }
+  #if ENABLE_DEBUG >= DEBUG_VERBOSE
+    CkCallback cb(CkReductionTarget(Main, ReceiveVisitsLoadedCount), mainProxy);
+    contribute(sizeof(int), &numVisits, CkReduction::sum_int, cb);
+  #endif
+}
 
-      // Seek while same person on same day
-      while (personId == person.getUniqueId() && visitStart < nextDaySecs) {
-        // Save visit info
-        person.visitsByDay[day].emplace_back(locationId, personId, -1,
-            visitStart, visitStart + visitDuration, 1.0);
-        #ifdef ENABLE_DEBUG
-          numVisits++;
-        #endif
-
-        std::tie(personId, locationId, visitStart, visitDuration) =
-          DataReader<Person>::parseActivityStream(activityData,
-              diseaseModel->activityDef, NULL);
+void People::loadVisitDay(int day) {
+  if (!visitLines) {
+    visitFile.reset(new InputFile(scenarioPath + "visits.csv"));
+    visitLines.reset(new LineReader(visitFile.get(), 0, visitFile->getSize(),
+        VISIT_STREAM_BUFFER_SIZE));
+  }
+
+  // Each time the schedule repeats, everyone starts over from their first
+  // visit. Visits are sorted by start time, so otherwise each person's
+  // visits for this day start wherever the last day's left off
+  int scheduleDay = day % numDaysWithDistinctVisits;
+  int dayIdx = day % visitWindow;
+  if (0 == scheduleDay) {
+    nextVisitOffsets = firstVisitOffsets;
+  }
+
+  Id firstLocalPersonId = getFirstIndex(thisIndex, numPeople,
+      numPeoplePartitions, firstPersonIdx);
+  Id personId = -1;
+  Id locationId = -1;
+  Time visitStart = -1;
+  Time visitDuration = -1;
+  schedule.startDay(dayIdx);
+  for (Id i = 0; i < numLocalPeople; ++i) {
+    if (EMPTY_VISIT_SCHEDULE == nextVisitOffsets[i]) {
+      continue;
+    }
+
+    // People's visits are usually close together in the file, so this
+    // mostly moves around within the reader's buffer
+    visitLines->seek(nextVisitOffsets[i]);
+    while (true) {
+      CacheOffset offset = visitLines->tell();
+      std::tie(personId, locationId, visitStart, visitDuration) =
+        DataReader<Person>::parseActivityStream(visitLines.get(),
+            *diseaseModel->activityPlan);
+      if (firstLocalPersonId + i != personId
+          || scheduleDay < getDay(visitStart)) {
+        nextVisitOffsets[i] = offset;
+        break;
       }
+      schedule.addVisit(dayIdx, i, locationId,
+          visitStart - scheduleDay * DAY_LENGTH, visitDuration);
+    }
+  }
+  schedule.finishDay(dayIdx);
+}
+
+void People::PrefetchVisits(int day) {
+  loadVisitDay(day);
+}
 
-      // CkPrintf("  Chare %d: person %d has %u visits on day %d (offset %u)\n",
-      //     thisIndex, person.getUniqueId(), person.visitsByDay[day].size(),
-      //     day, seekPos);
+void People::loadBinaryVisitData(BinaryReader *activityData) {
+  #ifdef ENABLE_DEBUG
+    int numVisits = 0;
+  #endif
+  // Visits are grouped by person, so all of our visits are in one
+  // contiguous block of rows
+  Id firstLocalPersonIdx = getFirstIndex(thisIndex, numPeople,
+      numPeoplePartitions, 0);
+  const uint64_t *rowOffsets = activityData->mapGroupOffsets(
+      firstLocalPersonIdx, numLocalPeople);
+  Id firstRow = rowOffsets[0];
+  Id numRows = rowOffsets[numLocalPeople] - firstRow;
+
+  int locationColumn = activityData->getColumnIndex(ColumnRole::foreign_id);
+  int startColumn = activityData->getColumnIndex(ColumnRole::start_time);
+  int durationColumn = activityData->getColumnIndex(ColumnRole::duration);
+  if (-1 == locationColumn || -1 == startColumn || -1 == durationColumn) {
+    CkAbort("Error: binary visit data is missing required columns\n");
+  }
+  const Id *locationIds = reinterpret_cast<const Id *>(
+      activityData->mapColumn(locationColumn, firstRow, numRows));
+  const Time *starts = reinterpret_cast<const Time *>(
+      activityData->mapColumn(startColumn, firstRow, numRows));
+  const Time *durations = reinterpret_cast<const Time *>(
+      activityData->mapColumn(durationColumn, firstRow, numRows));
+
+  for (Id p = 0; p < numLocalPeople; ++p) {
+    for (Id r = rowOffsets[p] - firstRow; r < rowOffsets[p + 1] - firstRow;
+        ++r) {
+      int day = getDay(starts[r]);
+      if (numDaysWithDistinctVisits <= day) {
+        continue;
+      }
+      schedule.addVisit(day, p, locationIds[r], starts[r] - day * DAY_LENGTH,
+          durations[r]);
+      #ifdef ENABLE_DEBUG
+        numVisits++;
+      #endif
     }
   }
+  for (int d = 0; d < numDaysWithDistinctVisits; ++d) {
+    schedule.finishDay(d);
+  }
   #if ENABLE_DEBUG >= DEBUG_VERBOSE
     CkCallback cb(CkReductionTarget(Main, ReceiveVisitsLoadedCount), mainProxy);
     contribute(sizeof(int), &numVisits, CkReduction::sum_int, cb);
@@ -386,12 +508,38 @@ void People::pup(PUP::er &p) {
   p | numLocalPeople;
   p | day;
   p | totalVisitsForDay;
+  p | attributeStore;
   p | people;
+  p | schedule;
+  p | states;
+  p | nextStates;
+  p | secondsLeftInState;
+  p | interactions;
+  p | exposures;
   p | generator;
   p | stateSummaries;
+  p | scenarioPath;
+  p | firstVisitOffsets;
+  p | nextVisitOffsets;
+  p | visitedPartitionOffsets;
+  p | visitedPartitions;
+  p | sentStates;
+  p | sentModifiers;
+  p | sentFilters;
+  p | sentVisitMessages;
+  p | receivedInteractionMessages;
+  p | expectedInteractionMessages;
+  p | seedOffsets;
 
   if (p.isUnpacking()) {
     diseaseModel = globDiseaseModel.ckLocalBranch();
+    outgoingVisits.resize(numLocationPartitions);
+    if (residentVisits) {
+      outgoingUpdates.resize(numLocationPartitions);
+    }
+    for (Person &person : people) {
+      person.setStore(&attributeStore);
+    }
   }
 }
 
@@ -402,40 +550,33 @@ void People::SendVisitMessages() {
   Id maxId = 0;
   totalVisitsForDay = 0;
   #endif
-  int dayIdx = day % numDaysWithDistinctVisits;
-  for (const Person &person : people) {
+  int dayIdx = getScheduleDayIdx();
+  for (std::vector<VisitMessage> &batch : outgoingVisits) {
+    batch.clear();
+  }
+  // Locations keep each day's visits after the first week, so from then on
+  // they only need to hear about changes to our people
+  if (residentVisits) {
+    sendVisitorUpdates();
+    if (numDaysWithDistinctVisits <= day) {
+      reportVisitMessages();
+      return;
+    }
+  }
+  for (Id i = 0; i < numLocalPeople; ++i) {
     #if ENABLE_DEBUG >= DEBUG_PER_CHARE
-    minId = std::min(minId, person.getUniqueId());
-    maxId = std::max(maxId, person.getUniqueId());
+    minId = std::min(minId, people[i].getUniqueId());
+    maxId = std::max(maxId, people[i].getUniqueId());
     #endif
-    for (VisitMessage visitMessage : person.visitsByDay[dayIdx]) {
-      visitMessage.personState = person.state;
-      visitMessage.transmissionModifier = getTransmissionModifier(person);
-
-      // Interventions may cancel some visits
-      if (NULL != visitMessage.deactivatedBy) {
-        continue;
-      }
-      #if ENABLE_DEBUG >= DEBUG_VERBOSE
-      totalVisitsForDay++;
-      #endif
-
-      // Find process that owns that location
-      PartitionId locationPartition = getPartitionIndex(visitMessage.locationIdx,
-          numLocations, numLocationPartitions, firstLocationIdx);
-      // Send off the visit message.
-      #ifdef USE_HYPERCOMM
-      Aggregator* agg = aggregatorProxy.ckLocalBranch();
-      if (agg->visit_aggregator) {
-        agg->visit_aggregator->send(locationsArray[locationPartition], visitMessage);
-      } else {
-      #endif  // USE_HYPERCOMM
-        locationsArray[locationPartition].ReceiveVisitMessages(visitMessage);
-      #ifdef USE_HYPERCOMM
-      }
-      #endif  // USE_HYPERCOMM
+    // Everyone else's visits wait until we know which of them overlap
+    // infectious ones (see ReceiveHotWindows)
+    if (infectiousFirst && !diseaseModel->isInfectious(states[i])) {
+      continue;
     }
+    queueVisits(i, dayIdx, false);
   }
+  sendVisitBatches();
+  reportVisitMessages();
 
 #if ENABLE_DEBUG >= DEBUG_PER_CHARE
   if (0 == day) {
@@ -444,51 +585,325 @@ void People::SendVisitMessages() {
         minId, maxId);
   }
 #endif
+
+  if (residentVisits && numDaysWithDistinctVisits - 1 == day) {
+    // Every day's visits are now held by the Locations chares
+    schedule = VisitSchedule();
+  } else if (!infectiousFirst) {
+    prefetchNextDay();
+  }
+}
+
+void People::ReceiveHotWindows(CkReductionMsg *msg) {
+  const HotWindow *windows = reinterpret_cast<const HotWindow *>(
+      msg->getData());
+  hotWindows.assign(windows, windows + msg->getSize() / sizeof(HotWindow));
+  delete msg;
+  std::sort(hotWindows.begin(), hotWindows.end());
+
+  int dayIdx = getScheduleDayIdx();
+  for (std::vector<VisitMessage> &batch : outgoingVisits) {
+    batch.clear();
+  }
+  // People who are both susceptible and infectious were sent already
+  for (Id i = 0; i < numLocalPeople; ++i) {
+    if (diseaseModel->isSusceptible(states[i])
+        && !diseaseModel->isInfectious(states[i])) {
+      queueVisits(i, dayIdx, true);
+    }
+  }
+  sendVisitBatches();
+  reportVisitMessages();
+  std::vector<HotWindow>().swap(hotWindows);
+
+  prefetchNextDay();
 }
 
-double People::getTransmissionModifier(const Person &person) {
+inline int People::getScheduleDayIdx() const {
+  return 0 < visitWindow ? day % visitWindow
+    : day % numDaysWithDistinctVisits;
+}
+
+bool People::isHot(uint32_t locationOffset, Time start,
+    Time end) const {
+  // Each location's windows are disjoint, so only the last one to start
+  // before the visit ends can overlap it
+  HotWindow key(locationOffset, end, end);
+  auto next = std::lower_bound(hotWindows.begin(), hotWindows.end(), key);
+  if (hotWindows.begin() == next) {
+    return false;
+  }
+  const HotWindow &window = *(next - 1);
+  return locationOffset == window.locationOffset && start < window.end;
+}
+
+void People::queueVisits(Id localIdx, int dayIdx, bool onlyHot) {
+  const ScheduledVisit *visit = schedule.visitsBegin(dayIdx, localIdx);
+  const ScheduledVisit *end = schedule.visitsEnd(dayIdx, localIdx);
+  if (visit == end) {
+    return;
+  }
+  const Person &person = people[localIdx];
+  double transmissionModifier = getTransmissionModifier(localIdx,
+      states[localIdx]);
+  FilterMask visitFilters = person.getVisitFilters();
+  for (; visit != end; ++visit) {
+    // Interventions may cancel some visits. Resident visits are all sent,
+    // and are filtered by their locations instead
+    if (!residentVisits && 0 != (visit->filterMask & visitFilters)) {
+      continue;
+    }
+    PartitionId locationPartition;
+    VisitMessage visitMessage = schedule.getMessage(*visit,
+        person.getUniqueId(), states[localIdx], transmissionModifier,
+        &locationPartition);
+    if (onlyHot && !isHot(visit->locationOffset, visitMessage.visitStart,
+          visitMessage.visitEnd)) {
+      continue;
+    }
+    #if ENABLE_DEBUG >= DEBUG_VERBOSE
+    totalVisitsForDay++;
+    #endif
+
+    // Send off the visit message, or hold onto it to send with the rest
+    // of the visits to the same chare
+    #ifdef USE_HYPERCOMM
+    Aggregator* agg = aggregatorProxy.ckLocalBranch();
+    if (agg->visit_aggregator) {
+      agg->visit_aggregator->send(locationsArray[locationPartition], visitMessage);
+    } else {
+    #endif  // USE_HYPERCOMM
+      outgoingVisits[locationPartition].push_back(visitMessage);
+    #ifdef USE_HYPERCOMM
+    }
+    #endif  // USE_HYPERCOMM
+  }
+}
+
+void People::setUpResidentVisits() {
+  visitedPartitionOffsets.assign(1, 0);
+  visitedPartitions.clear();
+  std::vector<PartitionId> partitions;
+  for (Id i = 0; i < numLocalPeople; ++i) {
+    partitions.clear();
+    for (int d = 0; d < numDaysWithDistinctVisits; ++d) {
+      const ScheduledVisit *end = schedule.visitsEnd(d, i);
+      for (const ScheduledVisit *visit = schedule.visitsBegin(d, i);
+          visit != end; ++visit) {
+        PartitionId partition;
+        uint32_t localIdx;
+        getPartitionSlot(visit->locationOffset, numLocationsPerPartition,
+            numLocationPartitions, 0, &partition, &localIdx);
+        partitions.push_back(partition);
+      }
+    }
+    std::sort(partitions.begin(), partitions.end());
+    partitions.erase(std::unique(partitions.begin(), partitions.end()),
+        partitions.end());
+    visitedPartitions.insert(visitedPartitions.end(), partitions.begin(),
+        partitions.end());
+    visitedPartitionOffsets.push_back(visitedPartitions.size());
+  }
+
+  // Locations start out with what's in each person's visits, which are
+  // unfiltered
+  sentStates = states;
+  sentModifiers.resize(numLocalPeople);
+  for (Id i = 0; i < numLocalPeople; ++i) {
+    sentModifiers[i] = getTransmissionModifier(i, states[i]);
+  }
+  sentFilters.assign(numLocalPeople, 0);
+}
+
+void People::sendVisitorUpdates() {
+  for (std::vector<VisitorUpdate> &batch : outgoingUpdates) {
+    batch.clear();
+  }
+  for (Id i = 0; i < numLocalPeople; ++i) {
+    double modifier = getTransmissionModifier(i, states[i]);
+    FilterMask visitFilters = people[i].getVisitFilters();
+    if (sentStates[i] == states[i] && sentModifiers[i] == modifier
+        && sentFilters[i] == visitFilters) {
+      continue;
+    }
+    sentStates[i] = states[i];
+    sentModifiers[i] = modifier;
+    sentFilters[i] = visitFilters;
+
+    VisitorUpdate update(
+        static_cast<uint32_t>(people[i].getUniqueId() - firstPersonIdx),
+        states[i], modifier, visitFilters);
+    for (Id j = visitedPartitionOffsets[i];
+        j < visitedPartitionOffsets[i + 1]; ++j) {
+      outgoingUpdates[visitedPartitions[j]].push_back(update);
+    }
+  }
+
+  for (PartitionId p = 0; p < numLocationPartitions; ++p) {
+    std::vector<VisitorUpdate> &batch = outgoingUpdates[p];
+    if (!batch.empty()) {
+      locationsArray[p].ReceiveVisitorUpdates(batch.size(), batch.data());
+      ++sentVisitMessages[p];
+    }
+  }
+}
+
+void People::prefetchNextDay() {
+  // Today's visits have all been sent, so their slot is free to hold the
+  // first day which isn't in memory yet. That's loaded by a separate message
+  // so that it overlaps with the rest of the visit phase
+  if (0 < visitWindow && day + visitWindow < numDays) {
+    thisProxy[thisIndex].PrefetchVisits(day + visitWindow);
+  }
+}
+
+void People::sendVisitBatches() {
+  for (PartitionId p = 0; p < numLocationPartitions; ++p) {
+    std::vector<VisitMessage> &batch = outgoingVisits[p];
+    if (batch.empty()) {
+      continue;
+    }
+
+    int numVisits = static_cast<int>(batch.size());
+    if (ZERO_COPY_VISIT_BATCH_SIZE <= numVisits * sizeof(VisitMessage)) {
+      locationsArray[p].ReceiveLargeVisitBatch(numVisits,
+          CkSendBuffer(batch.data()));
+    } else {
+      locationsArray[p].ReceiveVisitBatch(numVisits, batch.data());
+    }
+    ++sentVisitMessages[p];
+  }
+}
+
+void People::reportVisitMessages() {
+  if (!countedPhases) {
+    return;
+  }
+  CkCallback cb(CkReductionTarget(Locations, ExpectVisitMessages),
+      locationsArray);
+  contribute(sentVisitMessages, CkReduction::sum_int, cb);
+  std::fill(sentVisitMessages.begin(), sentVisitMessages.end(), 0);
+}
+
+double People::getTransmissionModifier(Id localIdx, DiseaseState state) {
   if (-1 != diseaseModel->susceptibilityIndex
-      && diseaseModel->isSusceptible(person.state)) {
-    return person.getValue(diseaseModel->susceptibilityIndex).double_val;
+      && diseaseModel->isSusceptible(state)) {
+    return attributeStore.getColumn<double>(
+        diseaseModel->susceptibilityIndex)[localIdx];
   } else if (-1 != diseaseModel->infectivityIndex
-      && diseaseModel->isInfectious(person.state)) {
-    return person.getValue(diseaseModel->infectivityIndex).double_val;
+      && diseaseModel->isInfectious(state)) {
+    return attributeStore.getColumn<double>(
+        diseaseModel->infectivityIndex)[localIdx];
   }
   return 1.0;
 }
 
 void People::ReceiveInteractions(InteractionMessage interMsg) {
-  Id localIdx = getLocalIndex(interMsg.personIdx, thisIndex, numPeople,
-    numPeoplePartitions, firstPersonIdx);
+  receiveInteractions(interMsg.personOffset, interMsg.interactions.data(),
+      interMsg.interactions.data() + interMsg.interactions.size());
+  countInteractionMessage();
+}
+
+void People::ReceiveInteractionBatch(int numRecipients,
+    uint32_t *personOffsets, uint32_t *counts, int numInteractions,
+    Interaction *received) {
+  const Interaction *next = received;
+  for (int i = 0; i < numRecipients; ++i) {
+    receiveInteractions(personOffsets[i], next, next + counts[i]);
+    next += counts[i];
+  }
+  countInteractionMessage();
+}
+
+void People::ExpectInteractionMessages(CkReductionMsg *msg) {
+  const int *counts = reinterpret_cast<const int *>(msg->getData());
+  expectedInteractionMessages = counts[thisIndex];
+  delete msg;
+  checkInteractionsComplete();
+}
+
+void People::countInteractionMessage() {
+  if (countedPhases) {
+    ++receivedInteractionMessages;
+    checkInteractionsComplete();
+  }
+}
 
+void People::checkInteractionsComplete() {
+  if (receivedInteractionMessages != expectedInteractionMessages) {
+    return;
+  }
+  receivedInteractionMessages = 0;
+  expectedInteractionMessages = -1;
+  seedInfections();
+  EndOfDayStateUpdate();
+}
+
+void People::findSeedOffsets(int seed) {
+  std::vector<Id> initialInfections = getInitialInfections(seed, numPeople,
+      firstPersonIdx);
+  seedOffsets.resize(DAYS_TO_SEED_INFECTION);
+  for (int d = 0; d < DAYS_TO_SEED_INFECTION; ++d) {
+    // Main seeds people from the back of the list
+    for (int i = 0; i < INITIAL_INFECTIONS_PER_DAY
+        && !initialInfections.empty(); ++i) {
+      PartitionId peoplePartitionIdx;
+      uint32_t personOffset;
+      getPartitionSlot(initialInfections.back(), numPeoplePerPartition,
+          numPeoplePartitions, firstPersonIdx, &peoplePartitionIdx,
+          &personOffset);
+      initialInfections.pop_back();
+      if (thisIndex == peoplePartitionIdx) {
+        seedOffsets[d].push_back(personOffset);
+      }
+    }
+  }
+}
+
+void People::seedInfections() {
+  if (static_cast<int>(seedOffsets.size()) <= day) {
+    return;
+  }
+  // Make a super contagious visit for each person, just like Main's
+  Interaction seed(std::numeric_limits<double>::max(), 0, 0, 0,
+      std::numeric_limits<int>::max());
+  for (uint32_t personOffset : seedOffsets[day]) {
+    receiveInteractions(personOffset, &seed, &seed + 1);
+  }
+}
+
+inline void People::receiveInteractions(Id localIdx,
+    const Interaction *begin, const Interaction *end) {
+  // The sender already worked out where this person is
 #ifdef ENABLE_DEBUG
-  Id trueIdx = people[localIdx].getUniqueId();
-  if (interMsg.personIdx != trueIdx) {
-    CkAbort("Error on chare %d: Person %d's exposure at loc %d recieved by "
-        "person %d (local %d)\n",
-        thisIndex, interMsg.personIdx, interMsg.locationIdx, trueIdx,
-        localIdx);
+  if (numLocalPeople <= localIdx) {
+    CkAbort("Error on chare %d: exposure for local person " ID_PRINT_TYPE
+        " recieved, but the chare only has " ID_PRINT_TYPE " people\n",
+        thisIndex, localIdx, numLocalPeople);
   }
 #endif
 
-  if (0 > localIdx) {
-    CkAbort("    Delivered message to person %d (%d on chare %d)\n",
-        interMsg.personIdx, localIdx, thisIndex);
+  // Only the total propensity and one weighted choice of infector are
+  // needed, so these can be folded in as they arrive...
+  if (aggregateExposures) {
+    for (const Interaction *inter = begin; inter != end; ++inter) {
+      exposures[localIdx].accumulate(*inter, unitDistrib(generator));
+    }
+    return;
   }
 
-  // Just concatenate the interaction lists so that we can process all of the
-  // interactions at the end of the day
-  Person &person = people[localIdx];
-  person.interactions.insert(person.interactions.end(),
-    interMsg.interactions.cbegin(), interMsg.interactions.cend());
+  // ...otherwise, just concatenate the interaction lists so that we can
+  // process all of the interactions at the end of the day
+  interactions[localIdx].insert(interactions[localIdx].end(), begin, end);
 }
 
 void People::ReceiveIntervention(int interventionIdx) {
   const Intervention<Person> &inter =
     diseaseModel->getPersonIntervention(interventionIdx);
-  for (Person &person : people) {
+  for (Id i = 0; i < numLocalPeople; ++i) {
+    Person &person = people[i];
     if (person.willComply(interventionIdx)
-        && inter.test(person, &generator)) {
+        && inter.test(person, states[i], &generator)) {
       inter.apply(&person);
     }
   }
@@ -497,24 +912,40 @@ void People::ReceiveIntervention(int interventionIdx) {
 void People::EndOfDayStateUpdate() {
   // Get ready to count today's states
   DiseaseState totalStates = diseaseModel->getNumberOfStates();
-  int offset = totalStates * day;
+  Id *stateCounts = stateSummaries.data() + totalStates * day;
 
-  // Handle state transitions at the end of the day.
-  Id infectiousCount = 0;
+  // Everyone draws from the generator in the same order each day, whether
+  // or not they were exposed, so that results for a given seed don't change
 #if ENABLE_DEBUG >= DEBUG_VERBOSE
   Counter totalExposuresPerDay = 0;
 #endif
-  for (Person &person : people) {
+  Time *timers = secondsLeftInState.data();
+  for (Id i = 0; i < numLocalPeople; ++i) {
 #if ENABLE_DEBUG >= DEBUG_VERBOSE
-    totalExposuresPerDay += person.interactions.size();
+    if (aggregateExposures) {
+      totalExposuresPerDay += 0.0 < exposures[i].propensity;
+    } else {
+      totalExposuresPerDay += interactions[i].size();
+    }
 #endif
-    ProcessInteractions(&person);
-    UpdateDiseaseState(&person);
+    ProcessInteractions(i);
 
-    DiseaseState resultantState = person.state;
-    stateSummaries[resultantState + offset]++;
-    if (diseaseModel->isInfectious(resultantState)) {
-      infectiousCount++;
+    // Mark the passage of time, and handle the state transition if their
+    // time in this state is up
+    timers[i] -= DAY_LENGTH;
+    if (timers[i] <= 0) {
+      UpdateDiseaseState(i);
+    }
+  }
+
+  const DiseaseState *stateData = states.data();
+  for (Id i = 0; i < numLocalPeople; ++i) {
+    stateCounts[stateData[i]]++;
+  }
+  Id infectiousCount = 0;
+  for (DiseaseState s = 0; s < totalStates; ++s) {
+    if (diseaseModel->isInfectious(s)) {
+      infectiousCount += stateCounts[s];
     }
   }
 
@@ -538,11 +969,14 @@ void People::SendStats() {
     cb);
 }
 
-void People::ProcessInteractions(Person *person) {
+void People::ProcessInteractions(Id localIdx) {
   double totalPropensity = 0.0;
-  uint numInteractions = static_cast<uint>(person->interactions.size());
-  for (uint i = 0; i < numInteractions; ++i) {
-    totalPropensity += person->interactions[i].propensity;
+  if (aggregateExposures) {
+    totalPropensity = exposures[localIdx].propensity;
+  } else {
+    for (const Interaction &inter : interactions[localIdx]) {
+      totalPropensity += inter.propensity;
+    }
   }
 
   // Detemine whether or not this person was infected...
@@ -550,15 +984,21 @@ void People::ProcessInteractions(Person *person) {
 
   if (roll <= DAY_LENGTH) {
     // ...if they were, determine which interaction was responsible, by
-    // chooseing an interaction, with a weight equal to the propensity
-    roll = std::uniform_real_distribution<>(0, totalPropensity)(generator);
-    double partialSum = 0.0;
-    int interactionIdx;
-    for (interactionIdx = 0; interactionIdx < numInteractions;
-        ++interactionIdx) {
-      partialSum += person->interactions[interactionIdx].propensity;
-      if (partialSum > roll) {
-        break;
+    // chooseing an interaction, with a weight equal to the propensity. An
+    // aggregated exposure already holds an interaction chosen this way
+    if (!aggregateExposures) {
+      const std::vector<Interaction> &personInteractions =
+        interactions[localIdx];
+      uint numInteractions = static_cast<uint>(personInteractions.size());
+      roll = std::uniform_real_distribution<>(0, totalPropensity)(generator);
+      double partialSum = 0.0;
+      int interactionIdx;
+      for (interactionIdx = 0; interactionIdx < numInteractions;
+          ++interactionIdx) {
+        partialSum += personInteractions[interactionIdx].propensity;
+        if (partialSum > roll) {
+          break;
+        }
       }
     }
 
@@ -567,32 +1007,33 @@ void People::ProcessInteractions(Person *person) {
 
     // Mark that exposed healthy individuals should make transition at the end
     // of the day.
-    if (diseaseModel->isSusceptible(person->state)) {
-      person->secondsLeftInState = -1;
+    if (diseaseModel->isSusceptible(states[localIdx])) {
+      secondsLeftInState[localIdx] = -1;
     }
   }
 
-  person->interactions.clear();
+  if (aggregateExposures) {
+    exposures[localIdx] = Interaction(0.0, -1, -1, 0, 0);
+  } else {
+    interactions[localIdx].clear();
+  }
 }
 
-void People::UpdateDiseaseState(Person *person) {
-  // Transition to next state or mark the passage of time
-  person->secondsLeftInState -= DAY_LENGTH;
-  if (person->secondsLeftInState <= 0) {
-    // If they have already been infected
-    if (person->next_state != -1) {
-      person->state = person->next_state;
-      std::tie(person->next_state, person->secondsLeftInState) =
-        diseaseModel->transitionFromState(person->state, &generator);
+void People::UpdateDiseaseState(Id localIdx) {
+  // Transition to next state, now that their time in this one is up.
+  // If they have already been infected
+  if (nextStates[localIdx] != -1) {
+    states[localIdx] = nextStates[localIdx];
+    std::tie(nextStates[localIdx], secondsLeftInState[localIdx]) =
+      diseaseModel->transitionFromState(states[localIdx], &generator);
 
-    } else {
-      // Get which exposed state they should transition to.
-      std::tie(person->state, std::ignore) =
-        diseaseModel->transitionFromState(person->state, &generator);
-      // See where they will transition next.
-      std::tie(person->next_state, person->secondsLeftInState) =
-        diseaseModel->transitionFromState(person->state, &generator);
-    }
+  } else {
+    // Get which exposed state they should transition to.
+    std::tie(states[localIdx], std::ignore) =
+      diseaseModel->transitionFromState(states[localIdx], &generator);
+    // See where they will transition next.
+    std::tie(nextStates[localIdx], secondsLeftInState[localIdx]) =
+      diseaseModel->transitionFromState(states[localIdx], &generator);
   }
 }
 
@@ -11,8 +11,13 @@
 #include "DiseaseModel.h"
 #include "Interaction.h"
 #include "Person.h"
+#include "VisitSchedule.h"
 #include "Message.h"
 #include "intervention_model/Intervention.h"
+#include "readers/AttributeStore.h"
+#include "readers/BinaryFormat.h"
+#include "readers/InputFile.h"
+#include "readers/LineReader.h"
 
 #include <functional>
 #include <random>
@@ -24,6 +29,11 @@
 #include <memory>
 
 #define LOCATION_LAMBDA 5.2
+// Visits are streamed in with small reads, since each person's visits for a
+// single day are only a few lines
+#define VISIT_STREAM_BUFFER_SIZE 65536
+// Visit batches at least this large (in bytes) are sent with zero copy
+#define ZERO_COPY_VISIT_BATCH_SIZE 65536
 
 class People : public CBase_People {
  private:
@@ -31,14 +41,91 @@ class People : public CBase_People {
   Id numLocalPeople;
   Counter totalVisitsForDay;
   std::vector<Person> people;
+  // Attributes of every person, indexed by local index
+  AttributeStore attributeStore;
+  VisitSchedule schedule;
+  // Each person's disease state, the state they'll move to next, and how
+  // long until then, indexed the same as people. These are updated for
+  // everyone every day, so they're kept out of Person to keep those loops
+  // running over small, contiguous arrays
+  std::vector<DiseaseState> states;
+  std::vector<DiseaseState> nextStates;
+  std::vector<Time> secondsLeftInState;
+  // Interactions each person has had with infectious people today
+  std::vector<std::vector<Interaction> > interactions;
+  // Replaces interactions when aggregating exposures: each person's
+  // interactions today folded into one (see Interaction::accumulate)
+  std::vector<Interaction> exposures;
+  // Today's visits for each Locations chare, which are sent as one batch.
+  // Large batches are sent straight out of these buffers, so they're only
+  // reused once the next day's visits are sent, by which point the
+  // previous day's have all been delivered
+  std::vector<std::vector<VisitMessage> > outgoingVisits;
+  // When sending infectious visits first, the times someone infectious was
+  // at each location today, sorted by location and start
+  std::vector<HotWindow> hotWindows;
+  // With resident visits, the Locations chares each person visits on any
+  // day (person i's are [visitedPartitionOffsets[i],
+  // visitedPartitionOffsets[i + 1]) of visitedPartitions), what they were
+  // last told about the person, and the updates being sent to each chare
+  std::vector<Id> visitedPartitionOffsets;
+  std::vector<PartitionId> visitedPartitions;
+  std::vector<DiseaseState> sentStates;
+  std::vector<double> sentModifiers;
+  std::vector<FilterMask> sentFilters;
+  std::vector<std::vector<VisitorUpdate> > outgoingUpdates;
+  // With counted phases, how many visit messages we've sent each Locations
+  // chare this round, and how many interaction messages have arrived today
+  // out of how many are coming (or -1 until we've been told)
+  std::vector<int> sentVisitMessages;
+  int receivedInteractionMessages;
+  int expectedInteractionMessages;
+  // Also with counted phases, the local people to seed infections in on
+  // each of the first DAYS_TO_SEED_INFECTION days. These are the same ones
+  // Main would pick, so we never have to wait on seed messages
+  std::vector<std::vector<uint32_t> > seedOffsets;
   std::default_random_engine generator;
   DiseaseModel *diseaseModel;
   std::vector<Id> stateSummaries;
 
-  void ProcessInteractions(Person *person);
-  void UpdateDiseaseState(Person *person);
+  // Only used when visits are streamed in a day at a time (see visitWindow).
+  // For each person, these hold the offsets of their first visit and of the
+  // first one which hasn't been loaded yet (or EMPTY_VISIT_SCHEDULE if they
+  // have no visits). The files are reopened as needed after migrating
+  std::string scenarioPath;
+  std::vector<CacheOffset> firstVisitOffsets;
+  std::vector<CacheOffset> nextVisitOffsets;
+  std::unique_ptr<InputFile> visitFile;
+  std::unique_ptr<LineReader> visitLines;
+
+  void ProcessInteractions(Id localIdx);
+  void UpdateDiseaseState(Id localIdx);
   void loadPeopleData(std::string scenarioPath);
-  void loadVisitData(std::ifstream *activityData);
+  void loadCsvPeopleData(std::string scenarioPath);
+  void loadVisitData(LineReader *activityData);
+  void loadBinaryVisitData(BinaryReader *activityData);
+  void loadVisitDay(int day);
+  inline int getScheduleDayIdx() const;
+  // Adds a person's visits for today to outgoingVisits, optionally only
+  // those which overlap a hot window
+  void queueVisits(Id localIdx, int dayIdx, bool onlyHot);
+  bool isHot(uint32_t locationOffset, Time start, Time end) const;
+  void sendVisitBatches();
+  void setUpResidentVisits();
+  // Tells the Locations chares holding each person's resident visits about
+  // any change to their state, transmission modifier or visit filters
+  void sendVisitorUpdates();
+  // Tells each Locations chare how many visit messages to wait for
+  void reportVisitMessages();
+  // Moves on to the end of day update once every interaction message has
+  // arrived
+  void countInteractionMessage();
+  void checkInteractionsComplete();
+  void findSeedOffsets(int seed);
+  void seedInfections();
+  void prefetchNextDay();
+  inline void receiveInteractions(Id localIdx, const Interaction *begin,
+    const Interaction *end);
 
  public:
   explicit People(int seed, std::string scenarioPath);
@@ -47,8 +134,20 @@ class People : public CBase_People {
   void generatePeopleData(Id firstLocalPersonIndex);
   void generateVisitData();
   void SendVisitMessages();
-  double getTransmissionModifier(const Person &person);
+  // Sends the susceptible visits which overlap infectious ones, once
+  // they're known
+  void ReceiveHotWindows(CkReductionMsg *msg);
+  void PrefetchVisits(int day);
+  double getTransmissionModifier(Id localIdx, DiseaseState state);
   void ReceiveInteractions(InteractionMessage interMsg);
+  // Each Locations chare sends all of its interactions with our people at
+  // once: recipient i had counts[i] interactions, which follow those of the
+  // recipients before it
+  void ReceiveInteractionBatch(int numRecipients, uint32_t *personOffsets,
+    uint32_t *counts, int numInteractions, Interaction *received);
+  // With counted phases, the number of interaction messages sent to each
+  // People chare today
+  void ExpectInteractionMessages(CkReductionMsg *msg);
   void EndOfDayStateUpdate();
   void SendStats();
   void ReceiveIntervention(int interventionIdx);
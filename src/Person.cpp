@@ -7,7 +7,8 @@
 #include "Person.h"
 #include "Message.h"
 #include "protobuf/data.pb.h"
-#include "readers/AttributeTable.h"
+#include "readers/AttributeStore.h"
+#include "readers/StringPool.h"
 
 #include "charm++.h"
 #include <vector>
@@ -16,44 +17,12 @@
  * Defines attributes of a single person.
  */
 
-Person::Person(const AttributeTable &attributes, int numInterventions,
-    int startingState, int secondsLeftInState_, int numDays) :
-    DataInterface(attributes, numInterventions),
-    state(startingState), next_state(-1),
-    secondsLeftInState(secondsLeftInState_) {
-  // Create an entry for each day we have data for
-  this->visitsByDay.resize(numDays);
-}
-
-void Person::filterVisits(const void *cause, VisitTest keepVisit) {
-  for (std::vector<VisitMessage> &visits : visitsByDay) {
-    for (int i = 0; i < visits.size(); ++i) {
-      if (!keepVisit(visits[i])) {
-        visits[i].deactivatedBy = cause;
-      }
-    }
-  }
-}
-
-void Person::restoreVisits(const void *cause) {
-  for (std::vector<VisitMessage> &visits : visitsByDay) {
-    for (int i = 0; i < visits.size(); ++i) {
-      if (cause == visits[i].deactivatedBy) {
-        visits[i].deactivatedBy = NULL;
-      }
-    }
-  }
-}
+Person::Person(AttributeStore *store, Id row) : DataInterface(store, row) {}
 
 void Person::pup(PUP::er &p) {
   p | uniqueId;
-  p | state;
-  p | next_state;
-  p | secondsLeftInState;
-  p | interactions;
-  p | visitOffsetByDay;
-  p | visitsByDay;
-  p | data;
+  p | row;
+  p | visitFilters;
 }
 
 void Person::_print_information(loimos::proto::CSVDefinition *personDef) {
@@ -67,11 +36,12 @@ void Person::_print_information(loimos::proto::CSVDefinition *personDef) {
       printf("-- %s is ", field->field_name().c_str());
       if (field->has_unique_id() || field->has_int32()
           || field->has_foreign_id()) {
-        printf("%d\n", this->data[attr].int32_val);
+        printf("%d\n", getValue(attr).int32_val);
       } else if (field->has_string()) {
-        // printf("%s\n", this->data[attr].str.c_str());
+        printf("%s\n", StringPool::getNodePool().get(
+              getValue(attr).string_val).c_str());
       } else if (field->has_bool_()) {
-        printf("%s\n", this->data[attr].bool_val ? "True" : "False");
+        printf("%s\n", getValue(attr).bool_val ? "True" : "False");
       }
       attr++;
     }
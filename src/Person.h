@@ -10,41 +10,25 @@
 #include "Defs.h"
 #include "Message.h"
 #include "readers/DataInterface.h"
-#include "readers/AttributeTable.h"
+#include "readers/AttributeStore.h"
 
 #include "charm++.h"
 #include <vector>
 
+// Disease states, timers, the interactions people receive each day, and
+// their visit schedules are kept by their People chare in flat arrays,
+// since they're touched for everyone every day; this only holds the data
+// which is rarely accessed
 class Person : public DataInterface {
  public:
-  // Numeric disease state of the person.
-  int state;
-  int next_state;
-  int secondsLeftInState;
-
-  // If this is a susceptible person, this is a list of all of their
-  // interactions with infectious people in the past day
-  std::vector<Interaction> interactions;
-
-  // Integer byte offsets in visits file by day.
-  // For example, fseek(visitOffsetByDay[2]) would seek to the start
-  // of this person's visits on day 3.
-  std::vector<uint64_t> visitOffsetByDay;
-
-  // Holds visit messages for each day
-  std::vector<std::vector<VisitMessage> > visitsByDay;
-
   // Constructors and assignment operators
   Person() = default;
-  Person(const AttributeTable &attributes, int numInterventions,
-    int startingState, int timeLeftInState, int numDays);
+  Person(AttributeStore *store, Id row);
   Person(const Person&) = default;
   Person(Person&&) = default;
   Person& operator=(const Person&) = default;
   Person& operator=(Person&&) = default;
   ~Person() = default;
-  void filterVisits(const void *cause, VisitTest keepVisit) override;
-  void restoreVisits(const void *cause) override;
   // Lets charm++ migrate objects
   void pup(PUP::er &p);  // NOLINT(runtime/references)
   // Debugging.
@@ -34,6 +34,11 @@ using Time = int32_t;
 #define TIME_PROTOBUF_TYPE_CAP Int32
 #define TIME_PARSE std::atoi
 
+// Has one bit for each person or location intervention, marking those
+// which apply to an object or visit
+using FilterMask = uint32_t;
+#define MAX_INTERVENTIONS 32
+
 // For counting events (interactions, visits, exposures...)
 using Counter = double;
 #define COUNTER_PRINT_TYPE "%0.0f"
@@ -0,0 +1,237 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "VisitSchedule.h"
+#include "Types.h"
+#include "Defs.h"
+#include "Extern.h"
+#include "Message.h"
+#include "charm++.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#define EMPTY_SCHEDULE 0
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+VisitSchedule::VisitSchedule() : numPeople(0), scheduleOffsets(2, 0),
+    numReferences(1, 0), numUnusedVisits(0) {}
+
+VisitSchedule::VisitSchedule(Id numPeople_, int numDays) :
+    numPeople(numPeople_), days(numDays), scheduleOffsets(2, 0),
+    numReferences(1, 0), numUnusedVisits(0) {
+  for (int d = 0; d < numDays; ++d) {
+    startDay(d);
+  }
+}
+
+uint64_t VisitSchedule::hashVisits(const ScheduledVisit *begin,
+    const ScheduledVisit *end) {
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(begin);
+  const unsigned char *bytesEnd = reinterpret_cast<const unsigned char *>(end);
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (; bytes != bytesEnd; ++bytes) {
+    hash = (hash ^ *bytes) * FNV_PRIME;
+  }
+  return hash;
+}
+
+uint32_t VisitSchedule::intern(const std::vector<ScheduledVisit> &schedule) {
+  if (schedule.empty()) {
+    return EMPTY_SCHEDULE;
+  }
+
+  uint64_t hash = hashVisits(schedule.data(),
+      schedule.data() + schedule.size());
+  auto matches = scheduleIndex.equal_range(hash);
+  for (auto match = matches.first; match != matches.second; ++match) {
+    uint32_t scheduleId = match->second;
+    size_t length = scheduleOffsets[scheduleId + 1]
+      - scheduleOffsets[scheduleId];
+    if (length == schedule.size() && 0 == memcmp(
+          visits.data() + scheduleOffsets[scheduleId], schedule.data(),
+          length * sizeof(ScheduledVisit))) {
+      // Schedules nobody uses any more can be picked back up until they're
+      // compacted away
+      if (0 == numReferences[scheduleId]++) {
+        numUnusedVisits -= length;
+      }
+      return scheduleId;
+    }
+  }
+
+  if (std::numeric_limits<uint32_t>::max() - visits.size()
+      < schedule.size()) {
+    CkAbort("Error: too many distinct visits for one chare\n");
+  }
+  uint32_t scheduleId = static_cast<uint32_t>(numReferences.size());
+  visits.insert(visits.end(), schedule.begin(), schedule.end());
+  scheduleOffsets.push_back(static_cast<uint32_t>(visits.size()));
+  numReferences.push_back(1);
+  scheduleIndex.emplace(hash, scheduleId);
+  return scheduleId;
+}
+
+void VisitSchedule::release(uint32_t scheduleId) {
+  if (EMPTY_SCHEDULE != scheduleId && 0 == --numReferences[scheduleId]) {
+    numUnusedVisits += scheduleOffsets[scheduleId + 1]
+      - scheduleOffsets[scheduleId];
+  }
+}
+
+void VisitSchedule::compact() {
+  std::vector<uint32_t> newIds(numReferences.size(), EMPTY_SCHEDULE);
+  std::vector<ScheduledVisit> newVisits;
+  newVisits.reserve(visits.size() - numUnusedVisits);
+  std::vector<uint32_t> newOffsets(2, 0);
+  std::vector<uint32_t> newReferences(1, 0);
+  for (uint32_t s = EMPTY_SCHEDULE + 1; s < numReferences.size(); ++s) {
+    if (0 == numReferences[s]) {
+      continue;
+    }
+    newIds[s] = static_cast<uint32_t>(newReferences.size());
+    newVisits.insert(newVisits.end(), visits.begin() + scheduleOffsets[s],
+        visits.begin() + scheduleOffsets[s + 1]);
+    newOffsets.push_back(static_cast<uint32_t>(newVisits.size()));
+    newReferences.push_back(numReferences[s]);
+  }
+  for (Day &day : days) {
+    for (uint32_t &scheduleId : day.scheduleIds) {
+      scheduleId = newIds[scheduleId];
+    }
+  }
+
+  visits.swap(newVisits);
+  scheduleOffsets.swap(newOffsets);
+  numReferences.swap(newReferences);
+  numUnusedVisits = 0;
+  rebuildIndex();
+}
+
+void VisitSchedule::rebuildIndex() {
+  scheduleIndex.clear();
+  for (uint32_t s = EMPTY_SCHEDULE + 1; s < numReferences.size(); ++s) {
+    scheduleIndex.emplace(hashVisits(visits.data() + scheduleOffsets[s],
+          visits.data() + scheduleOffsets[s + 1]), s);
+  }
+}
+
+void VisitSchedule::finishPerson(Day *day) {
+  day->scheduleIds[day->lastPerson] = intern(day->pending);
+  day->numVisits += day->pending.size();
+  day->pending.clear();
+}
+
+void VisitSchedule::startDay(int dayIdx) {
+  Day &day = days[dayIdx];
+  for (uint32_t scheduleId : day.scheduleIds) {
+    release(scheduleId);
+  }
+  day.scheduleIds.assign(numPeople, EMPTY_SCHEDULE);
+  day.numVisits = 0;
+  day.pending.clear();
+  day.building = true;
+  day.lastPerson = 0;
+
+  // Days which are reloaded as the simulation goes may leave behind a lot
+  // of schedules which nobody follows any more
+  if (visits.size() < 2 * numUnusedVisits) {
+    compact();
+  } else if (scheduleIndex.empty()) {
+    rebuildIndex();
+  }
+}
+
+void VisitSchedule::addVisit(int dayIdx, Id localIdx, Id locationIdx,
+    Time start, Time duration) {
+  Day &day = days[dayIdx];
+  if (!day.building || localIdx < day.lastPerson) {
+    CkAbort("Error: visits for day %d must be added in order of person\n",
+        dayIdx);
+  }
+  if (localIdx != day.lastPerson && !day.pending.empty()) {
+    finishPerson(&day);
+  }
+  day.lastPerson = localIdx;
+
+  ScheduledVisit visit;
+  visit.locationOffset = static_cast<uint32_t>(locationIdx - firstLocationIdx);
+  visit.start = static_cast<uint32_t>(start);
+  visit.duration = static_cast<uint32_t>(duration);
+  visit.filterMask = ~static_cast<FilterMask>(0);
+  day.pending.push_back(visit);
+}
+
+void VisitSchedule::finishDay(int dayIdx) {
+  Day &day = days[dayIdx];
+  if (!day.pending.empty()) {
+    finishPerson(&day);
+  }
+  std::vector<ScheduledVisit>().swap(day.pending);
+  day.building = false;
+
+  // The index is only needed while loading, and is rebuilt when the next
+  // day starts
+  for (const Day &other : days) {
+    if (other.building) {
+      return;
+    }
+  }
+  std::unordered_multimap<uint64_t, uint32_t>().swap(scheduleIndex);
+}
+
+const ScheduledVisit *VisitSchedule::visitsBegin(int dayIdx,
+    Id localIdx) const {
+  return visits.data()
+    + scheduleOffsets[days[dayIdx].scheduleIds[localIdx]];
+}
+
+const ScheduledVisit *VisitSchedule::visitsEnd(int dayIdx,
+    Id localIdx) const {
+  return visits.data()
+    + scheduleOffsets[days[dayIdx].scheduleIds[localIdx] + 1];
+}
+
+size_t VisitSchedule::getNumVisits(int dayIdx) const {
+  return days[dayIdx].numVisits;
+}
+
+size_t VisitSchedule::getNumSchedules() const {
+  return numReferences.size();
+}
+
+VisitMessage VisitSchedule::getMessage(const ScheduledVisit &visit,
+    Id personIdx, DiseaseState state, double transmissionModifier,
+    PartitionId *locationPartition) const {
+  uint32_t localIdx;
+  getPartitionSlot(visit.locationOffset, numLocationsPerPartition,
+      numLocationPartitions, 0, locationPartition, &localIdx);
+  Time start = static_cast<Time>(visit.start);
+  return VisitMessage(localIdx,
+      static_cast<uint32_t>(personIdx - firstPersonIdx), state, start,
+      start + static_cast<Time>(visit.duration), transmissionModifier);
+}
+
+void VisitSchedule::pup(PUP::er &p) {
+  p | numPeople;
+  p | days;
+  p | visits;
+  p | scheduleOffsets;
+  p | numReferences;
+  p | numUnusedVisits;
+  if (p.isUnpacking()) {
+    for (const Day &day : days) {
+      if (day.building) {
+        rebuildIndex();
+        break;
+      }
+    }
+  }
+}
@@ -0,0 +1,110 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef VISITSCHEDULE_H_
+#define VISITSCHEDULE_H_
+
+#include "Types.h"
+#include "Message.h"
+#include "charm++.h"
+#include "pup_stl.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// A single visit as stored in a schedule. The location is relative to the
+// first location and times are in seconds from the start of the day, so
+// everything fits in 32 bits
+struct ScheduledVisit {
+  uint32_t locationOffset;
+  uint32_t start;
+  uint32_t duration;
+  // Person interventions which cancel this visit when they're active for
+  // the person. Every visit filter currently applies to all of a person's
+  // visits, but this lets one only cancel some of them
+  FilterMask filterMask;
+};
+PUPbytes(ScheduledVisit);
+
+// Holds the visits made by all of a People chare's people. Many people
+// follow exactly the same schedule on several days, and members of a
+// household often share one, so each distinct list of visits is only stored
+// once, packed into a single array. Each day then just holds the id of the
+// schedule followed by each person
+class VisitSchedule {
+ private:
+  struct Day {
+    // Local person p follows schedule scheduleIds[p]
+    std::vector<uint32_t> scheduleIds;
+    size_t numVisits;
+    // Set while the day is being loaded, when pending holds the visits of
+    // the person currently being added
+    bool building;
+    Id lastPerson;
+    std::vector<ScheduledVisit> pending;
+
+    Day() : numVisits(0), building(false), lastPerson(0) {}
+    void pup(PUP::er &p) {  // NOLINT(runtime/references)
+      p | scheduleIds;
+      p | numVisits;
+      p | building;
+      p | lastPerson;
+      p | pending;
+    }
+  };
+
+  Id numPeople;
+  std::vector<Day> days;
+  // Schedule s is made up of visits [scheduleOffsets[s],
+  // scheduleOffsets[s + 1]). Schedule 0 is always the empty schedule
+  std::vector<ScheduledVisit> visits;
+  std::vector<uint32_t> scheduleOffsets;
+  // How many person-days follow each schedule, so the visits of schedules
+  // which are no longer used can be reclaimed
+  std::vector<uint32_t> numReferences;
+  size_t numUnusedVisits;
+  // Finds existing copies of a schedule by its hash
+  std::unordered_multimap<uint64_t, uint32_t> scheduleIndex;
+
+  static uint64_t hashVisits(const ScheduledVisit *begin,
+    const ScheduledVisit *end);
+  // Returns the id of the schedule made up of these visits, adding it if
+  // it hasn't been seen before
+  uint32_t intern(const std::vector<ScheduledVisit> &schedule);
+  void release(uint32_t scheduleId);
+  // Drops the visits of unused schedules and renumbers the rest
+  void compact();
+  void rebuildIndex();
+  void finishPerson(Day *day);
+
+ public:
+  VisitSchedule();
+  VisitSchedule(Id numPeople, int numDays);
+
+  // Clears out a day so it can be filled in by addVisit. Visits have to be
+  // added in order of person
+  void startDay(int dayIdx);
+  void addVisit(int dayIdx, Id localIdx, Id locationIdx, Time start,
+    Time duration);
+  // Must be called after each day is loaded and before it's used
+  void finishDay(int dayIdx);
+
+  const ScheduledVisit *visitsBegin(int dayIdx, Id localIdx) const;
+  const ScheduledVisit *visitsEnd(int dayIdx, Id localIdx) const;
+  size_t getNumVisits(int dayIdx) const;
+  // Number of distinct schedules, including the empty one
+  size_t getNumSchedules() const;
+  // Expands a stored visit back into a message, and finds the Locations
+  // chare to send it to
+  VisitMessage getMessage(const ScheduledVisit &visit, Id personIdx,
+    DiseaseState state, double transmissionModifier,
+    PartitionId *locationPartition) const;
+
+  void pup(PUP::er &p);  // NOLINT(runtime/references)
+};
+
+#endif  // VISITSCHEDULE_H_
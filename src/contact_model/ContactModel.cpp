@@ -10,6 +10,7 @@
 #include "ContactModel.h"
 #include "MinMaxAlphaModel.h"
 
+#include <string>
 #include <vector>
 #include <random>
 
@@ -30,7 +31,7 @@ void ContactModel::setGenerator(std::default_random_engine *generator) {
 
 // We don't need to do anything here, since we don't do anything
 // location-specific
-void ContactModel::computeLocationValues(Location *location) {}
+void ContactModel::computeLocationValues(AttributeStore *locationData) {}
 
 // Just use a constant probability
 bool ContactModel::madeContact(const Event &susceptibleEvent,
@@ -42,6 +43,10 @@ double ContactModel::getContactProbability(const Location &location) const {
   return DEFAULT_CONTACT_PROBABILITY;
 }
 
+std::vector<std::string> ContactModel::getUsedAttributes() {
+  return {};
+}
+
 ContactModel *createContactModel() {
   if (static_cast<int>(ContactModelType::constant_probability) == contactModelType) {
     return new ContactModel();
@@ -50,3 +55,10 @@ ContactModel *createContactModel() {
     return new MinMaxAlphaModel();
   }
 }
+
+std::vector<std::string> getContactModelAttributes() {
+  if (static_cast<int>(ContactModelType::min_max_alpha) == contactModelType) {
+    return MinMaxAlphaModel::getUsedAttributes();
+  }
+  return ContactModel::getUsedAttributes();
+}
@@ -12,8 +12,11 @@ class ContactModel;
 
 #include "../Location.h"
 #include "../Event.h"
+#include "../readers/AttributeStore.h"
 
 #include <random>
+#include <string>
+#include <vector>
 
 // This is the default implmenetation, which uses a constant contact
 // probability for every pair of people at every location. Other implmentations
@@ -35,14 +38,18 @@ class ContactModel {
   ContactModel& operator=(ContactModel &&other) = default;
   void setGenerator(std::default_random_engine *generator);
   // Calculates any location-specific values and stores them as new
-  // attributes of the location
-  virtual void computeLocationValues(Location *location);
+  // attributes of the locations. Since computed attributes migrate with
+  // their chare, this should only find the existing ones if called again
+  virtual void computeLocationValues(AttributeStore *locationData);
   // Returns whether or not two people at the same location make contact
   // (will probably need to mess with the arguments once we start
   // implementing more complex models)
   virtual bool madeContact(const Event &susceptibleEvent,
     const Event &infectiousEvent, const Location &location);
   virtual double getContactProbability(const Location &location) const;
+  // Names of the location attributes this model looks up, so that they get
+  // loaded. Subclasses which use any should hide this
+  static std::vector<std::string> getUsedAttributes();
 };
 
 // This enum provides an easy way of specifying which contact model to use.
@@ -52,5 +59,8 @@ enum class ContactModelType { constant_probability, min_max_alpha };
 // This creates a new instance of the contact model class indicated by
 // the global variable contactModelType
 ContactModel *createContactModel();
+// Returns the attributes used by the contact model createContactModel
+// would create
+std::vector<std::string> getContactModelAttributes();
 
 #endif  // CONTACT_MODEL_CONTACTMODEL_H_
@@ -13,6 +13,7 @@
 #include "ContactModel.h"
 #include "MinMaxAlphaModel.h"
 
+#include <string>
 #include <vector>
 #include <random>
 
@@ -20,30 +21,45 @@
 const unsigned int MIN = 5;
 const unsigned int MAX = 40;
 const unsigned int ALPHA = 1000;
+// Name of the attribute this adds to each location
+const char CONTACT_PROBABILITY_ATTRIBUTE[] = "contact_probability";
 
 MinMaxAlphaModel::MinMaxAlphaModel() {
   contactProbabilityIndex = -1;
 }
 
-// Compute this location's contact probability and store it as an attribute
-void MinMaxAlphaModel::computeLocationValues(Location *location) {
-  std::vector<union Data> &data = location->getData();
+// Each location's maximum number of simultaneous visits is read from the
+// location csv (see maxSimVisitsIdx)
+std::vector<std::string> MinMaxAlphaModel::getUsedAttributes() {
+  return {MAX_SIM_VISITS_ATTRIBUTE};
+}
 
-  if (-1 == contactProbabilityIndex) {
-    contactProbabilityIndex = static_cast<int>(data.size());
+// Compute each location's contact probability and store it as an attribute
+void MinMaxAlphaModel::computeLocationValues(AttributeStore *locationData) {
+  contactProbabilityIndex =
+    locationData->getColumnIndex(CONTACT_PROBABILITY_ATTRIBUTE);
+  if (-1 != contactProbabilityIndex) {
+    return;
   }
+  union Data defaultValue;
+  defaultValue.double_val = 0.0;
+  contactProbabilityIndex = locationData->addColumn(
+      CONTACT_PROBABILITY_ATTRIBUTE, DataTypes::double_, defaultValue);
 
   // This is the probability (NOT propensity) of two people who are a location
   // at the same time coming into contact. MIN, MAX, and ALPHA are constant for
   // all locations, but the maximum number if simultaneous visits (max_visits)
   // varies by location
-  union Data contactProbability;
-  double max_visits =
-    static_cast<double>(data[maxSimVisitsIdx].int32_val);
-  contactProbability.double_val = fmin(1,
-    (MIN + (MAX - MIN) * (1.0 - exp(-max_visits / ALPHA))) / (max_visits - 1));
-
-  data.push_back(contactProbability);
+  const int32_t *maxSimVisits =
+    locationData->getColumn<int32_t>(maxSimVisitsIdx);
+  double *contactProbabilities =
+    locationData->getMutableColumn<double>(contactProbabilityIndex);
+  for (Id r = 0; r < locationData->getNumRows(); ++r) {
+    double max_visits = static_cast<double>(maxSimVisits[r]);
+    contactProbabilities[r] = fmin(1,
+      (MIN + (MAX - MIN) * (1.0 - exp(-max_visits / ALPHA)))
+      / (max_visits - 1));
+  }
 }
 
 // Use this location's contact probability
@@ -10,8 +10,11 @@
 #include "../Location.h"
 #include "../Event.h"
 #include "ContactModel.h"
+#include "../readers/AttributeStore.h"
 
 #include <random>
+#include <string>
+#include <vector>
 
 // Each location has a fixed probability of two people making contact which
 // depends on the maximum number of simultaneous visits to that location,
@@ -26,10 +29,11 @@ class MinMaxAlphaModel : public ContactModel {
   // We need to re-declare all of these methods from ContactModel so
   // we can override them
   MinMaxAlphaModel();
-  void computeLocationValues(Location *location) override;
+  void computeLocationValues(AttributeStore *locationData) override;
   bool madeContact(const Event &susceptibleEvent,
     const Event& infectiousEvent, const Location &location) override;
   double getContactProbability(const Location &location) const override;
+  static std::vector<std::string> getUsedAttributes();
 };
 
 #endif  // CONTACT_MODEL_MINMAXALPHAMODEL_H_
@@ -11,9 +11,13 @@
 #include "../protobuf/disease.pb.h"
 #include "../readers/DataInterface.h"
 #include "../readers/AttributeTable.h"
+#include "../Types.h"
 
 #include "charm++.h"
 
+#include <string>
+#include <vector>
+
 using InterventionList = google::protobuf::RepeatedPtrField<
   loimos::proto::InterventionModel::Intervention>;
 
@@ -23,22 +27,42 @@ class Intervention {
   static std::uniform_real_distribution<double> unitDistrib;
   double compliance;
   int triggerIndex;
+  // Position among the person or location interventions, which is also
+  // this intervention's bit in any FilterMask
+  int index;
 
  public:
   int getTriggerIndex() const {
     return triggerIndex;
   }
+  int getIndex() const {
+    return index;
+  }
+  void setIndex(int index_) {
+    index = index_;
+  }
   bool willComply(const T &p, std::default_random_engine *generator) const {
     return unitDistrib(*generator) < compliance;
   }
   virtual bool test(const T &p, std::default_random_engine *generator) const {
     return false;
   }
+  // People's disease states are stored apart from the rest of their data,
+  // so interventions which depend on them get the state passed in as well
+  virtual bool test(const T &p, DiseaseState state,
+      std::default_random_engine *generator) const {
+    return test(p, generator);
+  }
   // Applies intervention to object
   virtual void apply(T *p) const {}
   // Undoes any previous intervention application on this object.
   // For any intervention that cannot be undone, this should have no effect.
   virtual void remove(T *p) const {}
+  // Names of the attributes this kind of intervention looks up, so that
+  // they get loaded. Subclasses which use any should hide this
+  static std::vector<std::string> getUsedAttributes() {
+    return {};
+  }
 
   Intervention() {}
   Intervention(
@@ -47,6 +71,7 @@ class Intervention {
       const AttributeTable &t) {
     compliance = interventionDef.compliance();
     triggerIndex = interventionDef.trigger_index();
+    index = -1;
   }
 };
 
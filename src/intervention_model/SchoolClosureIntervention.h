@@ -14,6 +14,10 @@
 #include "../protobuf/disease.pb.h"
 #include "../readers/DataInterface.h"
 #include "../readers/AttributeTable.h"
+#include "../Defs.h"
+
+#include <string>
+#include <vector>
 
 class SchoolClosureIntervention : public VisitFilterIntervention<Location> {
  protected:
@@ -24,7 +28,10 @@ class SchoolClosureIntervention : public VisitFilterIntervention<Location> {
       const loimos::proto::DiseaseModel &diseaseDef,
       const AttributeTable &t) :
     VisitFilterIntervention<Location>(interventionDef, diseaseDef, t) {
-    schoolIndex = t.getAttributeIndex("school");
+    schoolIndex = t.getAttributeIndex(SCHOOL_ATTRIBUTE);
+  }
+  static std::vector<std::string> getUsedAttributes() {
+    return {SCHOOL_ATTRIBUTE};
   }
 
   bool test(const Location &p, std::default_random_engine *generator) const override {
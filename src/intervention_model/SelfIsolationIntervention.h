@@ -27,8 +27,10 @@ class SelfIsolationIntervention : public VisitFilterIntervention<Person> {
       const loimos::proto::DiseaseModel &diseaseDef_,
       const AttributeTable &t) : diseaseDef(diseaseDef_),
     VisitFilterIntervention<Person>(interventionDef, diseaseDef_, t) {}
-  virtual bool test(const Person &p, std::default_random_engine *generator) const {
-    return diseaseDef.disease_states(p.state).symptomatic();
+  using VisitFilterIntervention<Person>::test;
+  bool test(const Person &p, DiseaseState state,
+      std::default_random_engine *generator) const override {
+    return diseaseDef.disease_states(state).symptomatic();
   }
 };
 
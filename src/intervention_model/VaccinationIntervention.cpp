@@ -9,7 +9,9 @@
 #include "../protobuf/interventions.pb.h"
 #include "../readers/DataInterface.h"
 #include "../readers/AttributeTable.h"
+#include "../Defs.h"
 
+#include <string>
 #include <vector>
 
 VaccinationIntervention::VaccinationIntervention(
@@ -22,8 +24,12 @@ VaccinationIntervention::VaccinationIntervention(
     .vaccinated_susceptibility();
   // CkPrintf("Vaccination: prob: %f, susceptibility: %f\n",
   //     vaccinationProbability, vaccinatedSusceptibility);
-  this->vaccinatedIndex = t.getAttributeIndex("vaccinated");
-  this->susceptibilityIndex = t.getAttributeIndex("susceptibility");
+  this->vaccinatedIndex = t.getAttributeIndex(VACCINATED_ATTRIBUTE);
+  this->susceptibilityIndex = t.getAttributeIndex(SUSCEPTIBILITY_ATTRIBUTE);
+}
+
+std::vector<std::string> VaccinationIntervention::getUsedAttributes() {
+  return {VACCINATED_ATTRIBUTE, SUSCEPTIBILITY_ATTRIBUTE};
 }
 
 bool VaccinationIntervention::test(const Person &p,
@@ -33,7 +39,11 @@ bool VaccinationIntervention::test(const Person &p,
 }
 
 void VaccinationIntervention::apply(Person *p) const {
-  std::vector<union Data> &objData = p->getData();
-  objData[vaccinatedIndex].bool_val = true;
-  objData[susceptibilityIndex].double_val = vaccinatedSusceptibility;
+  union Data vaccinated;
+  vaccinated.bool_val = true;
+  p->setValue(vaccinatedIndex, vaccinated);
+
+  union Data susceptibility;
+  susceptibility.double_val = vaccinatedSusceptibility;
+  p->setValue(susceptibilityIndex, susceptibility);
 }
@@ -16,6 +16,9 @@
 
 #include "charm++.h"
 
+#include <string>
+#include <vector>
+
 class VaccinationIntervention : public Intervention<Person> {
  private:
   double vaccinationProbability;
@@ -29,6 +32,7 @@ class VaccinationIntervention : public Intervention<Person> {
       const loimos::proto::DiseaseModel &diseaseDef,
       const AttributeTable &t);
   VaccinationIntervention() {}
+  static std::vector<std::string> getUsedAttributes();
 
   bool test(const Person &p, std::default_random_engine *generator)
       const override;
@@ -12,28 +12,21 @@
 #include "../readers/AttributeTable.h"
 
 #include "charm++.h"
-#include <functional>
 
 template <class T = DataInterface>
 class VisitFilterIntervention : public Intervention<T> {
- protected:
-  VisitTest keepVisit;
  public:
   VisitFilterIntervention(
       const loimos::proto::InterventionModel::Intervention &interventionDef,
       const loimos::proto::DiseaseModel &diseaseDef,
       const AttributeTable &t) :
-    Intervention<T>(interventionDef, diseaseDef, t) {
-    keepVisit = [](const VisitMessage &visit) {
-      return false;
-    };
-  }
+    Intervention<T>(interventionDef, diseaseDef, t) {}
 
   void apply(T *p) const override {
-    p->filterVisits(this, keepVisit);
+    p->filterVisits(this->getIndex());
   }
   void remove(T *p) const override {
-    p->restoreVisits(this);
+    p->restoreVisits(this->getIndex());
   }
 };
 
@@ -0,0 +1,202 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "AttributeStore.h"
+#include "AttributeTable.h"
+#include "BinaryFormat.h"
+#include "StringPool.h"
+#include "Data.h"
+#include "../Types.h"
+
+#include "charm++.h"
+#include "pup_stl.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define BITS_PER_WORD 64
+
+AttributeStore::AttributeStore() : numRows(0) {}
+
+AttributeStore::AttributeStore(const AttributeTable &attributes, Id numRows_,
+    int numInterventions) : numRows(numRows_) {
+  for (int i = 0; i < attributes.size(); ++i) {
+    addColumn(attributes.getName(i), attributes.getDataType(i),
+        attributes.getDefaultValue(i));
+  }
+
+  compliance.resize(numInterventions);
+  for (std::vector<uint64_t> &bits : compliance) {
+    bits.resize((numRows + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+  }
+}
+
+Id AttributeStore::getNumRows() const {
+  return numRows;
+}
+
+int AttributeStore::getNumColumns() const {
+  return static_cast<int>(columns.size());
+}
+
+int AttributeStore::getColumnIndex(const std::string &name) const {
+  for (int i = 0; i < getNumColumns(); ++i) {
+    if (names[i] == name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int AttributeStore::addColumn(const std::string &name,
+    DataTypes::DataType type, union Data defaultValue) {
+  uint32_t width = getBinaryWidth(type);
+  names.push_back(name);
+  types.push_back(type);
+  widths.push_back(width);
+  columns.emplace_back(numRows * width);
+  sharedColumns.emplace_back();
+
+  // Values are stored in the leading bytes of the union, just as they are
+  // in binary files
+  char *column = columns.back().data();
+  for (Id r = 0; r < numRows; ++r) {
+    memcpy(column + r * width, &defaultValue, width);
+  }
+  return getNumColumns() - 1;
+}
+
+DataTypes::DataType AttributeStore::getDataType(int column) const {
+  return types[column];
+}
+
+uint32_t AttributeStore::getWidth(int column) const {
+  return widths[column];
+}
+
+union Data AttributeStore::get(int column, Id row) const {
+  union Data value;
+  value.uint64_val = 0;
+  memcpy(&value, getColumnData(column) + row * widths[column],
+      widths[column]);
+  return value;
+}
+
+void AttributeStore::set(int column, Id row, union Data value) {
+  memcpy(getMutableColumnData(column) + row * widths[column], &value,
+      widths[column]);
+}
+
+void AttributeStore::shareColumn(int column,
+    std::shared_ptr<const char> data) {
+  if (!data) {
+    return;
+  }
+  sharedColumns[column] = data;
+  std::vector<char>().swap(columns[column]);
+}
+
+bool AttributeStore::isShared(int column) const {
+  return static_cast<bool>(sharedColumns[column]);
+}
+
+const char *AttributeStore::getColumnData(int column) const {
+  if (sharedColumns[column]) {
+    return sharedColumns[column].get();
+  }
+  return columns[column].data();
+}
+
+char *AttributeStore::getMutableColumnData(int column) {
+  // Only the rows of shared columns which this chare owns are copied
+  if (sharedColumns[column]) {
+    const char *shared = sharedColumns[column].get();
+    columns[column].assign(shared, shared + numRows * widths[column]);
+    sharedColumns[column].reset();
+  }
+  return columns[column].data();
+}
+
+bool AttributeStore::willComply(int interventionIdx, Id row) const {
+  return (compliance[interventionIdx][row / BITS_PER_WORD]
+      >> (row % BITS_PER_WORD)) & 1;
+}
+
+void AttributeStore::setCompliance(int interventionIdx, Id row,
+    bool value) {
+  uint64_t &word = compliance[interventionIdx][row / BITS_PER_WORD];
+  uint64_t mask = static_cast<uint64_t>(1) << (row % BITS_PER_WORD);
+  if (value) {
+    word |= mask;
+  } else {
+    word &= ~mask;
+  }
+}
+
+void AttributeStore::pup(PUP::er &p) {
+  p | numRows;
+  p | names;
+  p | widths;
+  p | compliance;
+
+  if (p.isUnpacking()) {
+    columns.resize(names.size());
+    sharedColumns.resize(names.size());
+  }
+  for (int c = 0; c < getNumColumns(); ++c) {
+    size_t length = numRows * widths[c];
+    if (p.isUnpacking()) {
+      columns[c].resize(length);
+      PUParray(p, columns[c].data(), length);
+    } else {
+      PUParray(p, const_cast<char *>(getColumnData(c)), length);
+    }
+  }
+
+  std::vector<int> typeIds(types.begin(), types.end());
+  p | typeIds;
+  if (p.isUnpacking()) {
+    types.clear();
+    for (int type : typeIds) {
+      types.push_back(static_cast<DataTypes::DataType>(type));
+    }
+  }
+
+  StringPool &pool = StringPool::getNodePool();
+  for (int c = 0; c < getNumColumns(); ++c) {
+    if (DataTypes::string_ != types[c]) {
+      continue;
+    }
+
+    // Only send each distinct value once
+    StringId *ids = getMutableColumn<StringId>(c);
+    std::vector<StringId> handles;
+    std::vector<std::string> values;
+    if (!p.isUnpacking()) {
+      handles.assign(ids, ids + numRows);
+      std::sort(handles.begin(), handles.end());
+      handles.erase(std::unique(handles.begin(), handles.end()),
+          handles.end());
+      for (StringId handle : handles) {
+        values.push_back(pool.get(handle));
+      }
+    }
+    p | handles;
+    p | values;
+
+    if (p.isUnpacking()) {
+      std::unordered_map<StringId, StringId> localIds;
+      for (size_t i = 0; i < handles.size(); ++i) {
+        localIds[handles[i]] = pool.intern(values[i]);
+      }
+      for (Id r = 0; r < numRows; ++r) {
+        ids[r] = localIds[ids[r]];
+      }
+    }
+  }
+}
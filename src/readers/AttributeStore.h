@@ -0,0 +1,88 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef READERS_ATTRIBUTESTORE_H_
+#define READERS_ATTRIBUTESTORE_H_
+
+#include "AttributeTable.h"
+#include "Data.h"
+#include "../Types.h"
+
+#include "charm++.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Holds the attributes of all of a chare's people or locations column by
+// column. Each attribute's values are contiguous and only take as many bytes
+// per row as their type needs, and each intervention's compliance flags are
+// packed into a bitset. Objects only keep their row, so a pass over one
+// attribute or intervention doesn't drag any of the others through the cache.
+// Columns which are loaded straight from a binary file can be shared with
+// every other process on the node through a read-only mapping, and are only
+// copied into the store if they're written to
+class AttributeStore {
+ private:
+  Id numRows;
+  std::vector<std::string> names;
+  std::vector<DataTypes::DataType> types;
+  std::vector<uint32_t> widths;
+  std::vector<std::vector<char> > columns;
+  // Set instead of the matching entry of columns for shared columns
+  std::vector<std::shared_ptr<const char> > sharedColumns;
+  // One bit per row for each intervention
+  std::vector<std::vector<uint64_t> > compliance;
+
+ public:
+  AttributeStore();
+  // Starts every row off with the table's default values, not complying
+  // with any interventions
+  AttributeStore(const AttributeTable &attributes, Id numRows,
+    int numInterventions);
+  Id getNumRows() const;
+  int getNumColumns() const;
+  // Returns -1 if there's no column with this name
+  int getColumnIndex(const std::string &name) const;
+  // Adds a column for values computed after loading, such as those a
+  // contact model needs, and returns its index
+  int addColumn(const std::string &name, DataTypes::DataType type,
+    union Data defaultValue);
+  DataTypes::DataType getDataType(int column) const;
+  // Bytes used by each row of a column
+  uint32_t getWidth(int column) const;
+
+  union Data get(int column, Id row) const;
+  void set(int column, Id row, union Data value);
+  // Replaces a column's values with read-only data owned by someone else,
+  // such as a mapping of a binary file
+  void shareColumn(int column, std::shared_ptr<const char> data);
+  bool isShared(int column) const;
+
+  // Access to a whole column, which holds getWidth(column) bytes per row.
+  // The mutable versions copy shared columns first
+  const char *getColumnData(int column) const;
+  char *getMutableColumnData(int column);
+  // Typed versions of the above; T must match the column's type
+  template <class T>
+  const T *getColumn(int column) const {
+    return reinterpret_cast<const T *>(getColumnData(column));
+  }
+  template <class T>
+  T *getMutableColumn(int column) {
+    return reinterpret_cast<T *>(getMutableColumnData(column));
+  }
+
+  bool willComply(int interventionIdx, Id row) const;
+  void setCompliance(int interventionIdx, Id row, bool value);
+
+  // String columns only hold handles into this node's pool, so their text
+  // is sent along with them and re-interned on the destination node. Shared
+  // columns are copied into the store on the destination
+  void pup(PUP::er &p);  // NOLINT(runtime/references)
+};
+
+#endif  // READERS_ATTRIBUTESTORE_H_
@@ -7,6 +7,7 @@
 #include "AttributeTable.h"
 #include "DataReader.h"
 #include "Data.h"
+#include "StringPool.h"
 #include "../loimos.decl.h"
 #include "../protobuf/data.pb.h"
 #include "../Types.h"
@@ -59,7 +60,7 @@ double AttributeTable::getDefaultValueAsDouble(int i) const {
 std::string AttributeTable::getName(int i) const {
   return list[i].name;
 }
-DataTypes::DataType AttributeTable::getDataType(int i) {
+DataTypes::DataType AttributeTable::getDataType(int i) const {
   return list[i].dataType;
 }
 int AttributeTable::size() const {
@@ -118,9 +119,10 @@ void AttributeTable::readAttributes(const AttributeList &attributes) {
         type = DataTypes::string_;
         if (field.default_value_case()
             == loimos::proto::DataField::DefaultValueCase::kDefaultString) {
-          defaultValue.string_val = new std::string(field.default_string());
+          defaultValue.string_val =
+            StringPool::getNodePool().intern(field.default_string());
         } else {
-          defaultValue.string_val = new std::string("");
+          defaultValue.string_val = StringPool::getNodePool().intern("");
         }
       } else {
         CkAbort("Error: attribute \"%s\" has invalid type\n",
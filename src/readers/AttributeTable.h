@@ -37,7 +37,7 @@ class AttributeTable {
   union Data getDefaultValue(int i) const;
   double getDefaultValueAsDouble(int i) const;
   std::string getName(int i) const;
-  DataTypes::DataType getDataType(int i);
+  DataTypes::DataType getDataType(int i) const;
   int getAttributeIndex(std::string name) const;
   int size() const;
   void updateIndex(int i, int newIndex);
@@ -0,0 +1,598 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * This file converts a scenario's csv files into a typed, columnar binary
+ * format which can be mmap'd directly by the People and Locations chares,
+ * so that repeated runs on the same population don't need to re-parse the
+ * csvs. Conversion only happens once per scenario; later runs reuse the
+ * existing .bin files.
+ */
+
+#include "../loimos.decl.h"
+#include "BinaryFormat.h"
+#include "Preprocess.h"
+#include "InputFile.h"
+#include "LineReader.h"
+#include "ParsePlan.h"
+#include "AttributeTable.h"
+#include "Data.h"
+#include "StringPool.h"
+#include "../Types.h"
+#include "../Defs.h"
+#include "../protobuf/data.pb.h"
+#include "charm++.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define BINARY_WRITE_BUFFER_SIZE 1048576  // 2^20
+#define BINARY_COLUMN_ALIGNMENT 64
+
+namespace {
+
+uint64_t align(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+void writeAt(int fd, const void *data, size_t length, uint64_t offset) {
+  const char *bytes = reinterpret_cast<const char *>(data);
+  while (0 < length) {
+    ssize_t written = pwrite(fd, bytes, length, offset);
+    if (0 > written) {
+      CkAbort("Error: failed to write binary data\n");
+    }
+    bytes += written;
+    length -= written;
+    offset += written;
+  }
+}
+
+void readAt(int fd, void *data, size_t length, uint64_t offset) {
+  char *bytes = reinterpret_cast<char *>(data);
+  while (0 < length) {
+    ssize_t numRead = pread(fd, bytes, length, offset);
+    if (0 >= numRead) {
+      CkAbort("Error: failed to read binary data\n");
+    }
+    bytes += numRead;
+    length -= numRead;
+    offset += numRead;
+  }
+}
+
+// Buffers the values for a single column so we can write them out in large
+// blocks while streaming through the csv
+// Parses a single (non-string) field into a value of the given type,
+// returning false if it isn't valid for that type
+bool parseValue(DataTypes::DataType dataType, const char *start,
+    const char *end, union Data *value) {
+  switch (dataType) {
+    case DataTypes::int32_:
+      return parseInteger(start, end, &value->int32_val);
+    case DataTypes::int64_:
+      return parseInteger(start, end, &value->int64_val);
+    case DataTypes::uint32_:
+      return parseUnsigned(start, end, &value->uint32_val);
+    case DataTypes::uint64_:
+      return parseUnsigned(start, end, &value->uint64_val);
+    case DataTypes::double_:
+      return parseDouble(start, end, &value->double_val);
+    case DataTypes::category_:
+      return parseUnsigned(start, end, &value->category_val);
+    case DataTypes::bool_:
+      value->bool_val = (1 == end - start)
+        && ('t' == *start || '1' == *start);
+      return true;
+    case DataTypes::string_:
+      return false;
+  }
+  return false;
+}
+
+struct ColumnWriter {
+  uint64_t nextOffset;
+  std::vector<char> buffer;
+
+  void append(int fd, const void *value, uint32_t width) {
+    const char *bytes = reinterpret_cast<const char *>(value);
+    buffer.insert(buffer.end(), bytes, bytes + width);
+    if (BINARY_WRITE_BUFFER_SIZE <= buffer.size()) {
+      flush(fd);
+    }
+  }
+
+  void flush(int fd) {
+    writeAt(fd, buffer.data(), buffer.size(), nextOffset);
+    nextOffset += buffer.size();
+    buffer.clear();
+  }
+};
+
+// Counts the data rows in a csv file, excluding the header
+uint64_t countRows(InputFile *input) {
+  std::vector<char> buf(BINARY_WRITE_BUFFER_SIZE);
+  uint64_t numLines = 0;
+  char last = '\n';
+  for (CacheOffset pos = 0; pos < input->getSize();) {
+    size_t numRead = input->read(buf.data(), buf.size(), pos);
+    for (size_t i = 0; i < numRead; ++i) {
+      numLines += '\n' == buf[i];
+    }
+    if (0 < numRead) {
+      last = buf[numRead - 1];
+    }
+    pos += numRead;
+  }
+  // Don't miss the last row if there's no trailing newline
+  if ('\n' != last) {
+    numLines++;
+  }
+  return 0 < numLines ? numLines - 1 : 0;
+}
+
+}  // namespace
+
+uint32_t getBinaryWidth(DataTypes::DataType dataType) {
+  switch (dataType) {
+    case DataTypes::int32_:
+    case DataTypes::uint32_:
+    case DataTypes::string_:
+      return 4;
+    case DataTypes::int64_:
+    case DataTypes::uint64_:
+    case DataTypes::double_:
+      return 8;
+    case DataTypes::category_:
+      return 2;
+    case DataTypes::bool_:
+      return 1;
+  }
+  return 0;
+}
+
+std::tuple<Id, Id> buildBinaryCache(std::string scenarioPath, Id numPeople,
+    Id numLocations) {
+  loimos::proto::CSVDefinition personDef;
+  loimos::proto::CSVDefinition locationDef;
+  loimos::proto::CSVDefinition activityDef;
+  readCSVDefinition(scenarioPath + "people.textproto", &personDef);
+  readCSVDefinition(scenarioPath + "locations.textproto", &locationDef);
+  readCSVDefinition(scenarioPath + "visits.textproto", &activityDef);
+
+  // People and locations are each one row per object...
+  std::string peoplePath = scenarioPath + "people" + BINARY_FILE_SUFFIX;
+  uint64_t peopleFingerprint = getSourceFingerprint(
+      scenarioPath + "people.csv", scenarioPath + "people.textproto");
+  if (!isValidBinaryFile(peoplePath, peopleFingerprint)) {
+    convertToBinary(scenarioPath + "people.csv", peoplePath, personDef, 0, 0,
+        peopleFingerprint);
+  } else {
+    CkPrintf("Using existing binary people data.\n");
+  }
+  BinaryReader peopleReader(peoplePath);
+  if (static_cast<Id>(peopleReader.getHeader().numRows) != numPeople) {
+    CkAbort("Error: expected %ld people but %s has %lu\n", numPeople,
+        peoplePath.c_str(), peopleReader.getHeader().numRows);
+  }
+  Id firstPersonIdx = peopleReader.getHeader().firstIdx;
+
+  std::string locationsPath = scenarioPath + "locations" + BINARY_FILE_SUFFIX;
+  uint64_t locationsFingerprint = getSourceFingerprint(
+      scenarioPath + "locations.csv", scenarioPath + "locations.textproto");
+  if (!isValidBinaryFile(locationsPath, locationsFingerprint)) {
+    convertToBinary(scenarioPath + "locations.csv", locationsPath,
+        locationDef, 0, 0, locationsFingerprint);
+  } else {
+    CkPrintf("Using existing binary location data.\n");
+  }
+  BinaryReader locationsReader(locationsPath);
+  if (static_cast<Id>(locationsReader.getHeader().numRows) != numLocations) {
+    CkAbort("Error: expected %ld locations but %s has %lu\n", numLocations,
+        locationsPath.c_str(), locationsReader.getHeader().numRows);
+  }
+  Id firstLocationIdx = locationsReader.getHeader().firstIdx;
+
+  // ...while visits are grouped by person
+  std::string visitsPath = scenarioPath + "visits" + BINARY_FILE_SUFFIX;
+  uint64_t visitsFingerprint = getSourceFingerprint(
+      scenarioPath + "visits.csv", scenarioPath + "visits.textproto");
+  bool upToDate = isValidBinaryFile(visitsPath, visitsFingerprint);
+  if (upToDate) {
+    BinaryReader visitsReader(visitsPath);
+    const BinaryHeader &header = visitsReader.getHeader();
+    upToDate = static_cast<Id>(header.numGroups) == numPeople
+      && header.groupFirstIdx == firstPersonIdx;
+  }
+  if (!upToDate) {
+    convertToBinary(scenarioPath + "visits.csv", visitsPath, activityDef,
+        numPeople, firstPersonIdx, visitsFingerprint);
+  } else {
+    CkPrintf("Using existing binary visit data.\n");
+  }
+
+  return std::make_tuple(firstPersonIdx, firstLocationIdx);
+}
+
+void convertToBinary(std::string inputPath, std::string outputPath,
+    const loimos::proto::CSVDefinition &csvDefinition, Id numGroups,
+    Id groupFirstIdx, uint64_t sourceFingerprint) {
+  double startTime = CkWallTimer();
+  InputFile input(inputPath);
+  uint64_t numRows = countRows(&input);
+
+  // Work out where each of the columns we're keeping will go...
+  AttributeTable attributes;
+  attributes.readAttributes(csvDefinition.fields());
+  int numFields = csvDefinition.fields_size();
+  std::vector<int> fieldColumns(numFields, -1);
+  std::vector<BinaryColumn> columns;
+  std::vector<union Data> defaults;
+  int idColumn = -1;
+  int attrIdx = 0;
+  for (int i = 0; i < numFields; ++i) {
+    const loimos::proto::DataField &field = csvDefinition.fields(i);
+    if (field.has_ignore()) {
+      continue;
+    }
+
+    BinaryColumn column;
+    memset(&column, 0, sizeof(BinaryColumn));
+    strncpy(column.name, field.field_name().c_str(),
+        BINARY_COLUMN_NAME_LENGTH - 1);
+    union Data defaultValue;
+    defaultValue.uint64_val = 0;
+    if (field.has_unique_id()) {
+      column.role = ColumnRole::unique_id;
+      column.dataType = DataTypes::CONCAT(ID_PROTOBUF_TYPE, _);
+      idColumn = static_cast<int>(columns.size());
+    } else {
+      if (field.has_foreign_id()) {
+        column.role = ColumnRole::foreign_id;
+      } else if (field.has_start_time()) {
+        column.role = ColumnRole::start_time;
+      } else if (field.has_duration()) {
+        column.role = ColumnRole::duration;
+      } else {
+        column.role = ColumnRole::attribute;
+      }
+      column.dataType = attributes.getDataType(attrIdx);
+      defaultValue = attributes.getDefaultValue(attrIdx);
+      attrIdx++;
+    }
+    column.width = getBinaryWidth(column.dataType);
+
+    fieldColumns[i] = static_cast<int>(columns.size());
+    columns.push_back(column);
+    defaults.push_back(defaultValue);
+  }
+  if (0 != numGroups && -1 == idColumn) {
+    CkAbort("Error: %s has no unique id to group by\n", inputPath.c_str());
+  }
+
+  // ...and lay them out one after the other
+  uint64_t offset = sizeof(BinaryHeader)
+    + columns.size() * sizeof(BinaryColumn);
+  for (BinaryColumn &column : columns) {
+    offset = align(offset, BINARY_COLUMN_ALIGNMENT);
+    column.start = offset;
+    offset += numRows * column.width;
+  }
+  offset = align(offset, BINARY_COLUMN_ALIGNMENT);
+  uint64_t groupTableStart = offset;
+  if (0 != numGroups) {
+    offset += (numGroups + 1) * sizeof(uint64_t);
+  }
+
+  // Write to a temporary file so an interrupted conversion is never
+  // mistaken for a complete one
+  std::string tmpPath = outputPath + ".tmp";
+  int fd = open(tmpPath.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+  if (-1 == fd) {
+    CkAbort("Error: could not create %s\n", tmpPath.c_str());
+  }
+
+  std::vector<ColumnWriter> writers(columns.size());
+  for (size_t c = 0; c < columns.size(); ++c) {
+    writers[c].nextOffset = columns[c].start;
+    writers[c].buffer.reserve(BINARY_WRITE_BUFFER_SIZE + sizeof(union Data));
+  }
+  std::vector<uint64_t> groupOffsets;
+  if (0 != numGroups) {
+    groupOffsets.resize(numGroups + 1);
+  }
+  Id nextGroup = 0;
+  Id firstIdx = 0;
+  std::unordered_map<std::string, uint32_t> stringIndices;
+  std::vector<std::string> strings;
+  auto internString = [&](const char *start, size_t length) {
+    auto it = stringIndices.find(std::string(start, length));
+    if (stringIndices.end() != it) {
+      return it->second;
+    }
+    uint32_t index = static_cast<uint32_t>(strings.size());
+    strings.emplace_back(start, length);
+    stringIndices.emplace(strings.back(), index);
+    return index;
+  };
+
+  // String columns hold indices into the string table rather than ids in
+  // the node's pool, so translate their defaults up front
+  for (size_t c = 0; c < columns.size(); ++c) {
+    if (DataTypes::string_ == columns[c].dataType) {
+      const std::string &str =
+        StringPool::getNodePool().get(defaults[c].string_val);
+      defaults[c].uint64_val = 0;
+      defaults[c].uint32_val = internString(str.data(), str.size());
+    }
+  }
+
+  // Stream through the csv, parsing each cell exactly once
+  ParsePlan plan(csvDefinition);
+  std::vector<union Data> values(columns.size());
+  LineReader reader(&input, LineReader::skipHeader(&input), input.getSize());
+  for (uint64_t row = 0; row < numRows; ++row) {
+    const char *line = "";
+    size_t length = 0;
+    CacheOffset lineOffset = reader.tell();
+    reader.nextLine(&line, &length, &lineOffset);
+
+    values = defaults;
+    bool hasId = false;
+    forEachField(line, length, plan,
+        [&](const ColumnPlan &column, const char *start, const char *end) {
+      int c = fieldColumns[&column - plan.columns.data()];
+      bool valid;
+      if (DataTypes::string_ == columns[c].dataType) {
+        values[c].uint32_val = internString(start, end - start);
+        valid = true;
+      } else {
+        valid = parseValue(columns[c].dataType, start, end, &values[c]);
+      }
+      if (!valid) {
+        CkAbort("Error at byte %lu of %s: could not parse '%.*s' in "
+            "'%.*s'\n", lineOffset, inputPath.c_str(),
+            static_cast<int>(end - start), start, static_cast<int>(length),
+            line);
+      }
+      if (c == idColumn) {
+        hasId = true;
+      }
+    });
+    if (-1 != idColumn && !hasId) {
+      CkAbort("Error at byte %lu of %s: missing unique id in row %lu\n",
+          lineOffset, inputPath.c_str(), row);
+    }
+
+    for (size_t c = 0; c < columns.size(); ++c) {
+      writers[c].append(fd, &values[c], columns[c].width);
+    }
+
+    if (-1 != idColumn) {
+      Id id = values[idColumn].CONCAT(ID_PROTOBUF_TYPE, _val);
+      if (0 == row) {
+        firstIdx = id;
+      }
+
+      if (0 != numGroups) {
+        Id group = id - groupFirstIdx;
+        if (0 > group || numGroups <= group || group < nextGroup - 1) {
+          CkAbort("Error: row %lu of %s has unexpected id %ld (rows "
+              "must be sorted by id)\n", row, inputPath.c_str(), id);
+        }
+        while (nextGroup <= group) {
+          groupOffsets[nextGroup++] = row;
+        }
+      }
+    }
+  }
+  for (ColumnWriter &writer : writers) {
+    writer.flush(fd);
+  }
+  if (0 != numGroups) {
+    while (nextGroup <= numGroups) {
+      groupOffsets[nextGroup++] = numRows;
+    }
+    writeAt(fd, groupOffsets.data(), groupOffsets.size() * sizeof(uint64_t),
+        groupTableStart);
+  }
+
+  // Strings go at the end, since we only know what they are now
+  uint64_t stringTableStart = align(offset, BINARY_COLUMN_ALIGNMENT);
+  std::vector<uint64_t> stringOffsets;
+  stringOffsets.reserve(strings.size() + 1);
+  uint64_t stringOffset = 0;
+  for (const std::string &str : strings) {
+    stringOffsets.push_back(stringOffset);
+    stringOffset += str.size();
+  }
+  stringOffsets.push_back(stringOffset);
+  writeAt(fd, stringOffsets.data(), stringOffsets.size() * sizeof(uint64_t),
+      stringTableStart);
+  offset = stringTableStart + stringOffsets.size() * sizeof(uint64_t);
+  for (const std::string &str : strings) {
+    writeAt(fd, str.data(), str.size(), offset);
+    offset += str.size();
+  }
+
+  BinaryHeader header;
+  memset(&header, 0, sizeof(BinaryHeader));
+  header.magic = BINARY_FORMAT_MAGIC;
+  header.version = BINARY_FORMAT_VERSION;
+  header.numColumns = static_cast<uint32_t>(columns.size());
+  header.numRows = numRows;
+  header.sourceFingerprint = sourceFingerprint;
+  header.firstIdx = firstIdx;
+  header.numGroups = numGroups;
+  header.groupFirstIdx = groupFirstIdx;
+  header.groupTableStart = groupTableStart;
+  header.stringTableStart = stringTableStart;
+  header.numStrings = strings.size();
+  writeAt(fd, &header, sizeof(BinaryHeader), 0);
+  writeAt(fd, columns.data(), columns.size() * sizeof(BinaryColumn),
+      sizeof(BinaryHeader));
+  close(fd);
+
+  if (0 != rename(tmpPath.c_str(), outputPath.c_str())) {
+    CkAbort("Error: could not move %s to %s\n", tmpPath.c_str(),
+        outputPath.c_str());
+  }
+  CkPrintf("Converted %lu rows of %s to %s in %f seconds\n", numRows,
+      inputPath.c_str(), outputPath.c_str(), CkWallTimer() - startTime);
+}
+
+bool isValidBinaryFile(std::string path, uint64_t sourceFingerprint) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (-1 == fd) {
+    return false;
+  }
+  BinaryHeader header;
+  ssize_t numRead = pread(fd, &header, sizeof(BinaryHeader), 0);
+  close(fd);
+  return sizeof(BinaryHeader) == numRead
+    && BINARY_FORMAT_MAGIC == header.magic
+    && BINARY_FORMAT_VERSION == header.version
+    && sourceFingerprint == header.sourceFingerprint;
+}
+
+uint64_t getSourceFingerprint(std::string csvPath,
+    std::string definitionPath) {
+  return getFilesFingerprint({csvPath, definitionPath});
+}
+
+BinaryReader::BinaryReader(std::string path) :
+    stringOffsets(NULL), stringData(NULL) {
+  fd = open(path.c_str(), O_RDONLY);
+  if (-1 == fd) {
+    CkAbort("Error: could not open %s\n", path.c_str());
+  }
+  readAt(fd, &header, sizeof(BinaryHeader), 0);
+  if (BINARY_FORMAT_MAGIC != header.magic
+      || BINARY_FORMAT_VERSION != header.version) {
+    CkAbort("Error: %s is not a valid binary file (version %u, expected "
+        "%u)\n", path.c_str(), header.version, BINARY_FORMAT_VERSION);
+  }
+  columns.resize(header.numColumns);
+  readAt(fd, columns.data(), header.numColumns * sizeof(BinaryColumn),
+      sizeof(BinaryHeader));
+}
+
+BinaryReader::~BinaryReader() {
+  for (const std::tuple<void *, size_t> &mapping : mappings) {
+    munmap(std::get<0>(mapping), std::get<1>(mapping));
+  }
+  close(fd);
+}
+
+const char *BinaryReader::mapRange(uint64_t start, uint64_t length) {
+  if (0 == length) {
+    return NULL;
+  }
+  void *mapped;
+  size_t mappedLength;
+  const char *data = mapUntracked(start, length, &mapped, &mappedLength);
+  mappings.emplace_back(mapped, mappedLength);
+  return data;
+}
+
+const char *BinaryReader::mapUntracked(uint64_t start, uint64_t length,
+    void **mapping, size_t *mappedLength) {
+  // mmap offsets have to be page-aligned
+  static const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+  uint64_t alignedStart = start - start % pageSize;
+  *mappedLength = length + (start - alignedStart);
+  *mapping = mmap(NULL, *mappedLength, PROT_READ, MAP_SHARED, fd,
+      alignedStart);
+  if (MAP_FAILED == *mapping) {
+    CkAbort("Error: failed to map %lu bytes of binary data\n", length);
+  }
+  return reinterpret_cast<const char *>(*mapping) + (start - alignedStart);
+}
+
+const BinaryHeader &BinaryReader::getHeader() const {
+  return header;
+}
+
+int BinaryReader::getNumColumns() const {
+  return static_cast<int>(columns.size());
+}
+
+const BinaryColumn &BinaryReader::getColumn(int c) const {
+  return columns[c];
+}
+
+int BinaryReader::getColumnIndex(const std::string &name) const {
+  for (int c = 0; c < getNumColumns(); ++c) {
+    if (ColumnRole::unique_id != columns[c].role && name == columns[c].name) {
+      return c;
+    }
+  }
+  return -1;
+}
+
+int BinaryReader::getColumnIndex(ColumnRole role) const {
+  for (int c = 0; c < getNumColumns(); ++c) {
+    if (role == columns[c].role) {
+      return c;
+    }
+  }
+  return -1;
+}
+
+const char *BinaryReader::mapColumn(int c, Id firstRow, Id numRows) {
+  const BinaryColumn &column = columns[c];
+  return mapRange(column.start + firstRow * column.width,
+      numRows * column.width);
+}
+
+std::shared_ptr<const char> BinaryReader::shareColumn(int c, Id firstRow,
+    Id numRows) {
+  const BinaryColumn &column = columns[c];
+  uint64_t length = numRows * column.width;
+  if (0 == length) {
+    return std::shared_ptr<const char>();
+  }
+  void *mapping;
+  size_t mappedLength;
+  const char *data = mapUntracked(column.start + firstRow * column.width,
+      length, &mapping, &mappedLength);
+  return std::shared_ptr<const char>(data,
+      [mapping, mappedLength](const char *) {
+        munmap(mapping, mappedLength);
+      });
+}
+
+const uint64_t *BinaryReader::mapGroupOffsets(Id firstGroup, Id numGroups) {
+  if (0 > firstGroup || header.numGroups < firstGroup + numGroups) {
+    CkAbort("Error: groups %ld-%ld out of range\n", firstGroup,
+        firstGroup + numGroups);
+  }
+  return reinterpret_cast<const uint64_t *>(mapRange(header.groupTableStart
+        + firstGroup * sizeof(uint64_t), (numGroups + 1) * sizeof(uint64_t)));
+}
+
+std::string BinaryReader::getString(uint32_t index) {
+  // The string table is only mapped once it's actually needed
+  if (NULL == stringOffsets) {
+    uint64_t tableLength = (header.numStrings + 1) * sizeof(uint64_t);
+    stringOffsets = reinterpret_cast<const uint64_t *>(
+        mapRange(header.stringTableStart, tableLength));
+    uint64_t numChars = stringOffsets[header.numStrings];
+    stringData = 0 == numChars ? "" :
+      mapRange(header.stringTableStart + tableLength, numChars);
+  }
+  return std::string(stringData + stringOffsets[index],
+      stringOffsets[index + 1] - stringOffsets[index]);
+}
@@ -0,0 +1,135 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef READERS_BINARYFORMAT_H_
+#define READERS_BINARYFORMAT_H_
+
+#include "Data.h"
+#include "../Types.h"
+#include "../protobuf/data.pb.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Identifies files written by convertToBinary ("LOIMOSBN" in little endian)
+#define BINARY_FORMAT_MAGIC 0x4e42534f4d494f4cULL
+// Bump this whenever the on-disk layout changes so stale files get rebuilt
+#define BINARY_FORMAT_VERSION 3
+#define BINARY_COLUMN_NAME_LENGTH 48
+#define BINARY_FILE_SUFFIX ".bin"
+
+// What a column is used for, mirroring the data_type oneof in data.proto
+enum class ColumnRole : uint32_t {
+  attribute, unique_id, foreign_id, start_time, duration
+};
+
+// Every binary file starts with this header, followed immediately by
+// numColumns BinaryColumn descriptors. All offsets are in bytes from the
+// start of the file
+struct BinaryHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t numColumns;
+  uint64_t numRows;
+  // Fingerprint of the csv and textproto this was converted from (see
+  // getFilesFingerprint), so the file is rebuilt when either changes
+  uint64_t sourceFingerprint;
+  // Value of the unique id column in the first row
+  Id firstIdx;
+  // Visits files are grouped by person; for each person p (relative to
+  // groupFirstIdx) the table at groupTableStart holds the index of p's first
+  // row, with one extra entry at the end holding numRows. Any partitioning
+  // of the people can read its row range straight out of this table
+  uint64_t numGroups;
+  Id groupFirstIdx;
+  uint64_t groupTableStart;
+  // String columns store 32-bit indices into this table, which consists of
+  // numStrings + 1 uint64_t offsets followed by the characters themselves
+  uint64_t stringTableStart;
+  uint64_t numStrings;
+};
+
+struct BinaryColumn {
+  char name[BINARY_COLUMN_NAME_LENGTH];
+  ColumnRole role;
+  DataTypes::DataType dataType;
+  uint32_t width;
+  uint32_t padding;
+  // Location of the value in row 0; row r is at start + r * width
+  uint64_t start;
+};
+
+// Returns the number of bytes used to store one value of the given type
+uint32_t getBinaryWidth(DataTypes::DataType dataType);
+
+// Converts any of the scenario's csv files which do not already have an
+// up-to-date binary equivalent, and returns the first person and location ids
+std::tuple<Id, Id> buildBinaryCache(std::string scenarioPath, Id numPeople,
+  Id numLocations);
+
+// Converts a single csv file into the columnar binary format. When
+// numGroups is non-zero, rows are grouped by their unique id, which is
+// expected to be sorted and to fall in [groupFirstIdx, groupFirstIdx +
+// numGroups)
+void convertToBinary(std::string inputPath, std::string outputPath,
+  const loimos::proto::CSVDefinition &csvDefinition, Id numGroups,
+  Id groupFirstIdx, uint64_t sourceFingerprint);
+
+// Checks that path is a binary file in the current format which was
+// converted from sources with the given fingerprint
+bool isValidBinaryFile(std::string path, uint64_t sourceFingerprint);
+// Fingerprint of a csv and the textproto describing it
+uint64_t getSourceFingerprint(std::string csvPath, std::string definitionPath);
+
+// Provides read-only access to slices of a binary file. Each slice is
+// mmap'd separately, so a chare only ever touches the pages covering its
+// own rows
+class BinaryReader {
+ private:
+  int fd;
+  BinaryHeader header;
+  std::vector<BinaryColumn> columns;
+  std::vector<std::tuple<void *, size_t> > mappings;
+  const uint64_t *stringOffsets;
+  const char *stringData;
+
+  const char *mapRange(uint64_t start, uint64_t length);
+  // Maps a range without keeping track of it, returning the start of the
+  // mapping and its length so the caller can unmap it
+  const char *mapUntracked(uint64_t start, uint64_t length, void **mapping,
+    size_t *mappedLength);
+
+ public:
+  explicit BinaryReader(std::string path);
+  ~BinaryReader();
+  BinaryReader(const BinaryReader &) = delete;
+  BinaryReader& operator=(const BinaryReader &) = delete;
+
+  const BinaryHeader &getHeader() const;
+  int getNumColumns() const;
+  const BinaryColumn &getColumn(int c) const;
+  // Returns -1 if there is no such column
+  int getColumnIndex(const std::string &name) const;
+  int getColumnIndex(ColumnRole role) const;
+
+  // Returns a pointer to the value in firstRow of column c, with at least
+  // numRows values mapped after it
+  const char *mapColumn(int c, Id firstRow, Id numRows);
+  // Like mapColumn, but the mapping outlives the reader and is only
+  // unmapped once every copy of the returned pointer is gone. The mapping
+  // is read-only and shared, so every process on a node reading the same
+  // rows uses the same pages of the page cache
+  std::shared_ptr<const char> shareColumn(int c, Id firstRow, Id numRows);
+  // Returns the first row of each of the groups in [firstGroup, firstGroup
+  // + numGroups], i.e. numGroups + 1 entries
+  const uint64_t *mapGroupOffsets(Id firstGroup, Id numGroups);
+  std::string getString(uint32_t index);
+};
+
+#endif  // READERS_BINARYFORMAT_H_
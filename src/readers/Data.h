@@ -7,10 +7,9 @@
 #ifndef READERS_DATA_H_
 #define READERS_DATA_H_
 
+#include "StringPool.h"
 #include "charm++.h"
 
-#include <string>
-
 namespace DataTypes {
   enum DataType {int32_, int64_, uint32_, uint64_, string_, double_, category_, bool_};
 }
@@ -23,7 +22,8 @@ union Data {
   uint64_t uint64_val;
   double double_val;
   uint16_t category_val;
-  std::string *string_val;
+  // Handle into the node's StringPool, so this stays plain data
+  StringId string_val;
 };
 PUPbytes(union Data);
 
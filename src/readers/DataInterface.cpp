@@ -5,23 +5,13 @@
  */
 
 #include "DataInterface.h"
-#include "AttributeTable.h"
+#include "AttributeStore.h"
 #include "../Types.h"
 
-DataInterface::DataInterface(const AttributeTable &attributes, int numInterventions) {
-  if (0 != numInterventions) {
-    willComplyWithIntervention.resize(numInterventions);
-  }
+DataInterface::DataInterface() : store(NULL), row(-1), visitFilters(0) {}
 
-  // Treat all attributes same, no need to make distinction
-  int tableSize = attributes.size();
-  if (tableSize != 0) {
-    data.resize(tableSize);
-    for (int i = 0; i < tableSize; i++) {
-      data[i] = attributes.getDefaultValue(i);
-    }
-  }
-}
+DataInterface::DataInterface(AttributeStore *store_, Id row_) :
+  store(store_), row(row_), visitFilters(0) {}
 
 void DataInterface::setUniqueId(Id idx) {
   uniqueId = idx;
@@ -31,18 +21,38 @@ Id DataInterface::getUniqueId() const {
   return uniqueId;
 }
 
+void DataInterface::setStore(AttributeStore *store_) {
+  store = store_;
+}
+
+Id DataInterface::getRow() const {
+  return row;
+}
+
 union Data DataInterface::getValue(int idx) const {
-  return data[idx];
+  return store->get(idx, row);
 }
 
-std::vector<union Data> &DataInterface::getData() {
-  return data;
+void DataInterface::setValue(int idx, union Data value) {
+  store->set(idx, row, value);
 }
 
 void DataInterface::toggleCompliance(int interventionIndex, bool value) {
-  willComplyWithIntervention[interventionIndex] = value;
+  store->setCompliance(interventionIndex, row, value);
+}
+
+bool DataInterface::willComply(int interventionIndex) const {
+  return store->willComply(interventionIndex, row);
+}
+
+void DataInterface::filterVisits(int interventionIndex) {
+  visitFilters |= static_cast<FilterMask>(1) << interventionIndex;
+}
+
+void DataInterface::restoreVisits(int interventionIndex) {
+  visitFilters &= ~(static_cast<FilterMask>(1) << interventionIndex);
 }
 
-bool DataInterface::willComply(int interventionIndex) {
-  return willComplyWithIntervention[interventionIndex];
+FilterMask DataInterface::getVisitFilters() const {
+  return visitFilters;
 }
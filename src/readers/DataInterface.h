@@ -15,6 +15,7 @@
 #include "pup_stl.h"
 #include "Data.h"
 #include "AttributeTable.h"
+#include "AttributeStore.h"
 #include "../Types.h"
 #include "../Message.h"
 #include "../protobuf/data.pb.h"
@@ -24,22 +25,27 @@ class DataInterface {
   // Unique global identifier
   Id uniqueId;
 
-  // Various dynamic attributes
-  std::vector<union Data> data;
-
-  // Indicates whether or not this entity will comply with a given intervention
-  std::vector<bool> willComplyWithIntervention;
+  // Attributes and compliance flags are kept column by column by the
+  // object's chare; this is the row holding this object's
+  AttributeStore *store;
+  Id row;
+  // Interventions currently cancelling this object's visits
+  FilterMask visitFilters;
  public:
-  DataInterface() = default;
-  DataInterface(const AttributeTable &attributes, int numInterventions);
+  DataInterface();
+  DataInterface(AttributeStore *store, Id row);
   virtual ~DataInterface() = default;
   void setUniqueId(Id idx);
   Id getUniqueId() const;
+  // Chares need to point their objects back at their store after migrating
+  void setStore(AttributeStore *store);
+  Id getRow() const;
   union Data getValue(int idx) const;
-  std::vector<union Data> &getData();
+  void setValue(int idx, union Data value);
   void toggleCompliance(int interventionIndex, bool value);
-  bool willComply(int interventionIndex);
-  virtual void filterVisits(const void *cause, VisitTest keepVisit) = 0;
-  virtual void restoreVisits(const void *cause) = 0;
+  bool willComply(int interventionIndex) const;
+  void filterVisits(int interventionIndex);
+  void restoreVisits(int interventionIndex);
+  FilterMask getVisitFilters() const;
 };
 #endif  // READERS_DATAINTERFACE_H_
@@ -8,16 +8,23 @@
 #define READERS_DATAREADER_H_
 
 #include "DataInterface.h"
+#include "AttributeTable.h"
+#include "AttributeStore.h"
+#include "BinaryFormat.h"
+#include "LineReader.h"
+#include "ParsePlan.h"
+#include "StringPool.h"
 #include "../protobuf/data.pb.h"
 #include "../Defs.h"
 
 #include <vector>
+#include <cstring>
 #include <stdio.h>
 #include <string>
 #include <fstream>
 #include <tuple>
+#include <unordered_map>
 
-#define MAX_INPUT_lineLength (std::streamsize) 262144  // 2^18
 #define CSV_DELIM ','
 
 /**
@@ -28,156 +35,201 @@
 template <class T = DataInterface>
 class DataReader {
  public:
-  static void readData(std::ifstream *input,
-      loimos::proto::CSVDefinition *dataFormat,
+  static void readData(LineReader *input, const ParsePlan &plan,
       std::vector<T> *dataObjs) {
-    char buf[MAX_INPUT_lineLength];
+    const char *line;
+    size_t length;
+    CacheOffset pos;
     // Rows to read.
     for (T &obj : *dataObjs) {
       // Get next line.
-      CacheOffset pos = input->tellg();
-      input->getline(buf, MAX_INPUT_lineLength);
-
-      // Read over people data format.
-      int attrIndex = 0;
-      // Tracks how many non-ignored fields there have been.
-      int numDataFields = 0;
-      int leftCommaLocation = 0;
-
-      int lineLength = input->gcount();
-      for (int c = 0; c < lineLength; c++) {
-        // Scan for the next attributes - comma separated.
-        if (buf[c] != CSV_DELIM && c + 1 != lineLength) {
-          continue;
-        }
+      if (!input->nextLine(&line, &length, &pos)) {
+        CkAbort("Error: ran out of data at byte %lu\n", pos);
+      }
 
-        // Get next attribute type.
-        loimos::proto::DataField const *field = &dataFormat->fields(attrIndex);
-        uint16_t dataLen = c - leftCommaLocation;
-        if (field->has_ignore() || dataLen == 0) {
-          // Skip
-        } else {
-          // Process data.
-          char *start = buf + leftCommaLocation;
-          if (c + 1 == lineLength) {
-            dataLen += 1;
-          }
-          std::string rawData(start, dataLen);
-          try {
-            numDataFields +=
-              DataReader<T>::parseObjectData(rawData, field, numDataFields, &obj);
-          } catch (const std::exception &e) {
-            CkPrintf("Error at byte %lu: '%s' (%s)\n", pos, buf, rawData.c_str());
-            CkAbort("%\n", e.what());
-          }
+      forEachField(line, length, plan,
+          [&](const ColumnPlan &column, const char *start, const char *end) {
+        if (!DataReader<T>::parseObjectData(column, start, end, &obj)) {
+          CkAbort("Error at byte %lu: could not parse '%.*s' in '%.*s'\n",
+              pos, static_cast<int>(end - start), start,
+              static_cast<int>(length), line);
         }
+      });
+    }
+  }
 
-        leftCommaLocation = c + 1;
-        attrIndex++;
+  // Copies the rows starting at firstRow of a converted binary file into
+  // the store's columns, matching columns to attributes by name. Row r of
+  // the store belongs to dataObjs[r]
+  static void readBinaryData(BinaryReader *input, Id firstRow,
+      const AttributeTable &attributes, AttributeStore *store,
+      std::vector<T> *dataObjs) {
+    Id numRows = static_cast<Id>(dataObjs->size());
+    int idColumn = input->getColumnIndex(ColumnRole::unique_id);
+    if (-1 != idColumn) {
+      const Id *ids = reinterpret_cast<const Id *>(
+          input->mapColumn(idColumn, firstRow, numRows));
+      for (Id r = 0; r < numRows; ++r) {
+        (*dataObjs)[r].setUniqueId(ids[r]);
+      }
+    }
+
+    for (int a = 0; a < attributes.size(); ++a) {
+      // Attributes which are only defined by the intervention model won't be
+      // in the file, so they just keep their default values
+      int c = input->getColumnIndex(attributes.getName(a));
+      if (-1 == c) {
+        continue;
+      }
+      const BinaryColumn &column = input->getColumn(c);
+      if (column.dataType != attributes.getDataType(a)) {
+        CkAbort("Error: attribute \"%s\" has type %d in binary file but "
+            "%d in definition\n", column.name, column.dataType,
+            attributes.getDataType(a));
+      }
+
+      // Both lay out values the same way, so most columns can just refer to
+      // the file's pages, which are shared by the whole node
+      if (DataTypes::string_ != column.dataType) {
+        store->shareColumn(a, input->shareColumn(c, firstRow, numRows));
+        continue;
+      }
+
+      // The file's strings are already deduplicated, so each one only
+      // needs to be looked up in the pool once
+      const char *values = input->mapColumn(c, firstRow, numRows);
+      std::unordered_map<uint32_t, StringId> stringIds;
+      StringId *strings = store->getMutableColumn<StringId>(a);
+      for (Id r = 0; r < numRows; ++r) {
+        uint32_t stringIdx;
+        memcpy(&stringIdx, values + r * column.width, sizeof(uint32_t));
+        auto it = stringIds.find(stringIdx);
+        if (stringIds.end() == it) {
+          it = stringIds.emplace(stringIdx, StringPool::getNodePool().intern(
+                input->getString(stringIdx))).first;
+        }
+        strings[r] = it->second;
       }
     }
   }
 
-  // Returns 1 if another field was set in the data vector of obj
-  // and 0 otherwise
-  static int parseObjectData(const std::string &rawData,
-      const loimos::proto::DataField *field, int fieldIdx, T *obj) {
-    std::vector<union Data> *data = &obj->getData();
+  // Returns false if the field wasn't valid for its type
+  static bool parseObjectData(const ColumnPlan &column, const char *start,
+      const char *end, T *obj) {
+    union Data value;
+    int64_t integer;
 
     // Parse byte stream to the correct representation.
-    if (field->has_unique_id()) {
-      obj->setUniqueId(ID_PARSE(rawData));
-      return 0;
-    } else {
-      if (field->has_int32()) {
-        data->at(fieldIdx).int32_val = std::stoi(rawData);
+    switch (column.kind) {
+      case ParseKind::unique_id:
+        if (!parseInteger(start, end, &integer)) {
+          return false;
+        }
+        obj->setUniqueId(integer);
+        return true;
 
-      } else if (field->has_int64()) {
-        data->at(fieldIdx).int64_val = std::stol(rawData);
+      case ParseKind::foreign_id:
+        if (!parseInteger(start, end, &integer)) {
+          return false;
+        }
+        value.CONCAT(ID_PROTOBUF_TYPE, _val) = integer;
+        break;
+
+      case ParseKind::start_time:
+      case ParseKind::duration:
+        if (!parseInteger(start, end,
+              &value.CONCAT(TIME_PROTOBUF_TYPE, _val))) {
+          return false;
+        }
+        break;
 
-      } else if (field->has_uint32()) {
-        data->at(fieldIdx).uint32_val =
-          static_cast<uint32_t>(std::stoi(rawData));
+      case ParseKind::int32:
+        if (!parseInteger(start, end, &value.int32_val)) {
+          return false;
+        }
+        break;
 
-      } else if (field->has_uint64()) {
-        data->at(fieldIdx).uint64_val =
-          static_cast<uint64_t>(std::stol(rawData));
+      case ParseKind::int64:
+        if (!parseInteger(start, end, &value.int64_val)) {
+          return false;
+        }
+        break;
 
-      } else if (field->has_foreign_id()) {
-        data->at(fieldIdx).CONCAT(ID_PROTOBUF_TYPE, _val) =
-          ID_PARSE(rawData);
+      case ParseKind::uint32:
+        if (!parseUnsigned(start, end, &value.uint32_val)) {
+          return false;
+        }
+        break;
 
-      } else if (field->has_double_()) {
-        data->at(fieldIdx).double_val = std::stod(rawData);
+      case ParseKind::uint64:
+        if (!parseUnsigned(start, end, &value.uint64_val)) {
+          return false;
+        }
+        break;
 
-      } else if (field->has_string()) {
-        data->at(fieldIdx).string_val = new std::string(rawData);
+      case ParseKind::category:
+        if (!parseUnsigned(start, end, &value.category_val)) {
+          return false;
+        }
+        break;
 
-      } else if (field->has_bool_()) {
-        data->at(fieldIdx).bool_val = (rawData.length() == 1)
-          && (rawData[0] == 't' || rawData[0] == '1');
-      }
+      case ParseKind::double_:
+        if (!parseDouble(start, end, &value.double_val)) {
+          return false;
+        }
+        break;
 
-      return 1;
+      case ParseKind::string:
+        value.string_val = StringPool::getNodePool().intern(start,
+            end - start);
+        break;
+
+      case ParseKind::bool_:
+        value.bool_val = (1 == end - start)
+          && ('t' == *start || '1' == *start);
+        break;
+
+      case ParseKind::skip:
+        return true;
     }
+    obj->setValue(column.slot, value);
+    return true;
   }
 
-  static std::tuple<Id, Id, Time, Time> parseActivityStream(std::ifstream *input,
-      loimos::proto::CSVDefinition *dataFormat, std::vector<union Data> *attributes) {
+  // Returns the next visit in input, or all -1s if there are none left
+  static std::tuple<Id, Id, Time, Time> parseActivityStream(LineReader *input,
+      const ParsePlan &plan) {
     Id personId = -1;
     Id locationId = -1;
     Time startTime = -1;
     Time duration = -1;
-    // TODO(IanCostello) don't reallocate this every time.
-    char buf[MAX_INPUT_lineLength];
-
-    // Get header line.
-    input->getline(buf, MAX_INPUT_lineLength);
-
-    // Read over people data format.
-    int attrIndex = 0;
-    int numDataFields = 0;
-    int leftCommaLocation = 0;
-
-    int lineLength = input->gcount();
-    for (int c = 0; c < lineLength; c++) {
-      // Scan for the next attributes - comma separated.
-      if (buf[c] == CSV_DELIM || c + 1 == lineLength) {
-        // Get next attribute type.
-        loimos::proto::DataField const *field = &dataFormat->fields(attrIndex);
-        uint16_t dataLen = c - leftCommaLocation;
-        if (field->has_ignore() || dataLen == 0) {
-          // Skip
-        } else if (numDataFields <= 3) {
-          // Process data.
-          char *start = buf + leftCommaLocation;
-          if (c + 1 == lineLength) {
-            dataLen += 1;
-          } else {
-            start[dataLen] = 0;
-          }
-
-          // Parse byte stream to the correct representation.
-          if (field->has_unique_id()) {
-            personId = ID_PARSE(start);
-
-          } else if (field->has_foreign_id()) {
-            locationId = ID_PARSE(start);
-
-          } else if (field->has_start_time()) {
-            startTime = TIME_PARSE(start);
-
-          } else if (field->has_duration()) {
-            duration = TIME_PARSE(start);
-
-          } else {
-            numDataFields++;
-          }
-        }
-        leftCommaLocation = c + 1;
-        attrIndex++;
-      }
+
+    const char *line;
+    size_t length;
+    CacheOffset pos;
+    if (!input->nextLine(&line, &length, &pos)) {
+      return std::make_tuple(personId, locationId, startTime, duration);
     }
+
+    forEachField(line, length, plan,
+        [&](const ColumnPlan &column, const char *start, const char *end) {
+      // Parse byte stream to the correct representation.
+      bool valid = true;
+      if (ParseKind::unique_id == column.kind) {
+        valid = parseInteger(start, end, &personId);
+      } else if (ParseKind::foreign_id == column.kind) {
+        valid = parseInteger(start, end, &locationId);
+      } else if (ParseKind::start_time == column.kind) {
+        valid = parseInteger(start, end, &startTime);
+      } else if (ParseKind::duration == column.kind) {
+        valid = parseInteger(start, end, &duration);
+      }
+      if (!valid) {
+        CkAbort("Error at byte %lu: could not parse '%.*s' in '%.*s'\n",
+            pos, static_cast<int>(end - start), start,
+            static_cast<int>(length), line);
+      }
+    });
     return std::make_tuple(personId, locationId, startTime, duration);
   }
 
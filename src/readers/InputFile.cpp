@@ -0,0 +1,219 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "InputFile.h"
+#include "../Types.h"
+#include "charm++.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+CacheOffset getFileSize(int fd) {
+  struct stat info;
+  if (0 != fstat(fd, &info)) {
+    CkAbort("Error: could not stat input file\n");
+  }
+  return static_cast<CacheOffset>(info.st_size);
+}
+
+void readFully(int fd, char *buffer, size_t length, CacheOffset offset,
+    const std::string &path) {
+  while (0 < length) {
+    ssize_t numRead = pread(fd, buffer, length, offset);
+    if (0 >= numRead) {
+      CkAbort("Error: failed to read %s at byte %lu\n", path.c_str(),
+          offset);
+    }
+    buffer += numRead;
+    length -= numRead;
+    offset += numRead;
+  }
+}
+
+uint32_t readUint32(const char *bytes) {
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(uint32_t));
+  return value;
+}
+}  // namespace
+
+InputFile::InputFile(std::string path_) : path(resolvePath(path_)),
+    compressed(false), bufferedFrame(0), context(NULL) {
+  fd = open(path.c_str(), O_RDONLY);
+  if (-1 == fd) {
+    CkAbort("Error: could not open %s\n", path_.c_str());
+  }
+
+  size = getFileSize(fd);
+  if (path != path_) {
+#ifdef ENABLE_ZSTD
+    compressed = true;
+    context = ZSTD_createDCtx();
+    readSeekTable();
+#else
+    CkAbort("Error: %s is compressed; rebuild with ENABLE_ZSTD to read it\n",
+        path.c_str());
+#endif
+  }
+}
+
+InputFile::~InputFile() {
+#ifdef ENABLE_ZSTD
+  ZSTD_freeDCtx(reinterpret_cast<ZSTD_DCtx *>(context));
+#endif
+  close(fd);
+}
+
+void InputFile::readSeekTable() {
+  CacheOffset fileSize = size;
+  if (fileSize < SKIPPABLE_HEADER_SIZE + SEEK_TABLE_FOOTER_SIZE) {
+    CkAbort("Error: %s is too small to be a seekable zstd file\n",
+        path.c_str());
+  }
+  char footer[SEEK_TABLE_FOOTER_SIZE];
+  readFully(fd, footer, SEEK_TABLE_FOOTER_SIZE,
+      fileSize - SEEK_TABLE_FOOTER_SIZE, path);
+  uint32_t numFrames = readUint32(footer);
+  bool hasChecksums = footer[4] & 0x80;
+  if (SEEK_TABLE_MAGIC != readUint32(footer + 5)) {
+    CkAbort("Error: %s has no seek table; compress it with "
+        "scripts/preprocessing/compress_seekable.py\n", path.c_str());
+  }
+
+  size_t entrySize = hasChecksums ? 12 : 8;
+  size_t tableSize = numFrames * entrySize;
+  CacheOffset frameStart = fileSize - SEEK_TABLE_FOOTER_SIZE - tableSize
+    - SKIPPABLE_HEADER_SIZE;
+  std::vector<char> table(SKIPPABLE_HEADER_SIZE + tableSize);
+  readFully(fd, table.data(), table.size(), frameStart, path);
+  if (SKIPPABLE_FRAME_MAGIC != readUint32(table.data())
+      || tableSize + SEEK_TABLE_FOOTER_SIZE
+        != readUint32(table.data() + 4)) {
+    CkAbort("Error: %s has a malformed seek table\n", path.c_str());
+  }
+
+  compressedStarts.resize(numFrames + 1, 0);
+  decompressedStarts.resize(numFrames + 1, 0);
+  size_t largestFrame = 0;
+  size_t largestCompressedFrame = 0;
+  for (uint32_t i = 0; i < numFrames; ++i) {
+    const char *entry = table.data() + SKIPPABLE_HEADER_SIZE + i * entrySize;
+    uint32_t compressedSize = readUint32(entry);
+    uint32_t decompressedSize = readUint32(entry + 4);
+    compressedStarts[i + 1] = compressedStarts[i] + compressedSize;
+    decompressedStarts[i + 1] = decompressedStarts[i] + decompressedSize;
+    largestFrame = std::max<size_t>(largestFrame, decompressedSize);
+    largestCompressedFrame = std::max<size_t>(largestCompressedFrame,
+        compressedSize);
+  }
+  if (compressedStarts[numFrames] != frameStart) {
+    CkAbort("Error: seek table of %s doesn't match its frames\n",
+        path.c_str());
+  }
+
+  size = decompressedStarts[numFrames];
+  frameBuffer.resize(largestFrame);
+  compressedBuffer.resize(largestCompressedFrame);
+  // Nothing has been decompressed yet
+  bufferedFrame = numFrames;
+}
+
+size_t InputFile::findFrame(CacheOffset offset) const {
+  return std::upper_bound(decompressedStarts.begin(),
+      decompressedStarts.end(), offset) - decompressedStarts.begin() - 1;
+}
+
+void InputFile::decompressFrame(size_t frame, char *dest) {
+#ifdef ENABLE_ZSTD
+  size_t compressedSize = compressedStarts[frame + 1]
+    - compressedStarts[frame];
+  size_t decompressedSize = decompressedStarts[frame + 1]
+    - decompressedStarts[frame];
+  readFully(fd, compressedBuffer.data(), compressedSize,
+      compressedStarts[frame], path);
+  size_t result = ZSTD_decompressDCtx(
+      reinterpret_cast<ZSTD_DCtx *>(context), dest, decompressedSize,
+      compressedBuffer.data(), compressedSize);
+  if (ZSTD_isError(result) || result != decompressedSize) {
+    CkAbort("Error: could not decompress frame %lu of %s\n", frame,
+        path.c_str());
+  }
+#endif
+}
+
+CacheOffset InputFile::getSize() const {
+  return size;
+}
+
+bool InputFile::isCompressed() const {
+  return compressed;
+}
+
+size_t InputFile::read(char *buffer, size_t length, CacheOffset offset) {
+  if (offset >= size) {
+    return 0;
+  }
+  length = std::min<CacheOffset>(length, size - offset);
+  if (!compressed) {
+    readFully(fd, buffer, length, offset, path);
+    return length;
+  }
+
+  size_t total = 0;
+  while (total < length) {
+    size_t frame = findFrame(offset);
+    CacheOffset frameOffset = offset - decompressedStarts[frame];
+    size_t frameSize = decompressedStarts[frame + 1]
+      - decompressedStarts[frame];
+    size_t toCopy = std::min<CacheOffset>(length - total,
+        frameSize - frameOffset);
+
+    // Whole frames can go straight to the caller
+    if (0 == frameOffset && frameSize == toCopy) {
+      decompressFrame(frame, buffer + total);
+    } else {
+      if (bufferedFrame != frame) {
+        decompressFrame(frame, frameBuffer.data());
+        bufferedFrame = frame;
+      }
+      memcpy(buffer + total, frameBuffer.data() + frameOffset, toCopy);
+    }
+    total += toCopy;
+    offset += toCopy;
+  }
+  return total;
+}
+
+void InputFile::adviseSequential(CacheOffset start, CacheOffset end) {
+  end = std::min(end, size);
+  if (start >= end) {
+    return;
+  }
+  if (compressed) {
+    start = compressedStarts[findFrame(start)];
+    end = compressedStarts[findFrame(end - 1) + 1];
+  }
+  posix_fadvise(fd, start, end - start, POSIX_FADV_SEQUENTIAL);
+}
+
+std::string InputFile::resolvePath(std::string path) {
+  struct stat info;
+  if (0 != stat(path.c_str(), &info)
+      && 0 == stat((path + COMPRESSED_SUFFIX).c_str(), &info)) {
+    return path + COMPRESSED_SUFFIX;
+  }
+  return path;
+}
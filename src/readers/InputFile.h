@@ -0,0 +1,72 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef READERS_INPUTFILE_H_
+#define READERS_INPUTFILE_H_
+
+#include "../Types.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Compressed inputs have this appended to the name of the csv they hold
+#define COMPRESSED_SUFFIX ".zst"
+// Marks the skippable frame holding a seekable zstd file's seek table, and
+// the end of the table itself
+#define SKIPPABLE_FRAME_MAGIC 0x184D2A5EU
+#define SEEK_TABLE_MAGIC 0x8F92EAB1U
+#define SEEK_TABLE_FOOTER_SIZE 9
+#define SKIPPABLE_HEADER_SIZE 8
+
+// A csv which is either stored as is or compressed in the seekable zstd
+// format (a series of independent zstd frames followed by a table of their
+// sizes). Either way, all offsets refer to the decompressed csv; the seek
+// table maps each offset to a frame and the offset within it, so only the
+// frames actually touched are ever decompressed
+class InputFile {
+ private:
+  std::string path;
+  int fd;
+  bool compressed;
+  CacheOffset size;
+
+  // Positions of each frame in the compressed and decompressed files. Both
+  // have an extra entry at the end holding the total size
+  std::vector<CacheOffset> compressedStarts;
+  std::vector<CacheOffset> decompressedStarts;
+  // The most recently decompressed frame, for reads which only need part
+  // of one
+  std::vector<char> frameBuffer;
+  std::vector<char> compressedBuffer;
+  size_t bufferedFrame;
+  void *context;
+
+  void readSeekTable();
+  size_t findFrame(CacheOffset offset) const;
+  void decompressFrame(size_t frame, char *dest);
+
+ public:
+  // Opens path, or path with COMPRESSED_SUFFIX if only that exists
+  explicit InputFile(std::string path);
+  ~InputFile();
+  InputFile(const InputFile &) = delete;
+  InputFile &operator=(const InputFile &) = delete;
+
+  // Size of the decompressed data
+  CacheOffset getSize() const;
+  bool isCompressed() const;
+  // Reads up to length bytes of decompressed data starting at offset,
+  // returning how many were read (only fewer at the end of the file)
+  size_t read(char *buffer, size_t length, CacheOffset offset);
+  // Lets the OS know the range will be read front to back
+  void adviseSequential(CacheOffset start, CacheOffset end);
+
+  // Returns whichever of path or its compressed version exists on disk
+  static std::string resolvePath(std::string path);
+};
+
+#endif  // READERS_INPUTFILE_H_
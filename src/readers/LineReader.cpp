@@ -0,0 +1,145 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "LineReader.h"
+#include "InputFile.h"
+#include "../Types.h"
+#include "charm++.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#define LINE_SEARCH_SIZE 4096
+
+LineReader::LineReader(InputFile *file_, CacheOffset start, CacheOffset end_,
+    size_t bufferSize) : file(file_), bufferStart(start), filled(0),
+    cursor(0) {
+  fileSize = file->getSize();
+  end = std::min(end_, fileSize);
+  // Small ranges don't need a full sized buffer (it will grow if a line
+  // runs past the end of the range). Leave room for a terminating null
+  bufferSize = std::max<CacheOffset>(1, std::min<CacheOffset>(bufferSize,
+        end - std::min(start, end)));
+  buffer.resize(bufferSize + 1);
+  buffer[0] = '\0';
+  data = buffer.data();
+  // Ranges are read front to back, so let the kernel read ahead of us
+  file->adviseSequential(start, end);
+}
+
+LineReader::LineReader(const char *contents, CacheOffset start,
+    CacheOffset end_) : file(NULL), end(end_), fileSize(end_), bufferStart(start),
+    data(contents), filled(end_ - start), cursor(0) {}
+
+bool LineReader::fill() {
+  // Everything is already in memory
+  if (NULL == file) {
+    return false;
+  }
+
+  // Keep whatever part of the current line we've already read
+  if (0 < cursor) {
+    memmove(buffer.data(), buffer.data() + cursor, filled - cursor);
+    bufferStart += cursor;
+    filled -= cursor;
+    cursor = 0;
+  }
+  // Lines longer than the buffer just make it grow
+  if (filled + 1 == buffer.size()) {
+    buffer.resize(2 * buffer.size());
+    data = buffer.data();
+  }
+
+  CacheOffset readStart = bufferStart + filled;
+  if (readStart >= fileSize) {
+    return false;
+  }
+  size_t numRead = file->read(buffer.data() + filled,
+      buffer.size() - 1 - filled, readStart);
+  filled += numRead;
+  buffer[filled] = '\0';
+  return 0 < numRead;
+}
+
+bool LineReader::nextLine(const char **line, size_t *length,
+    CacheOffset *offset) {
+  while (true) {
+    if (bufferStart + cursor >= end) {
+      return false;
+    }
+
+    const char *start = data + cursor;
+    const char *newline = reinterpret_cast<const char *>(
+        memchr(start, '\n', filled - cursor));
+    bool atEnd = false;
+    if (NULL == newline && !fill()) {
+      // The last line in the file might not have a newline
+      if (cursor == filled) {
+        return false;
+      }
+      atEnd = true;
+    }
+    if (NULL == newline && !atEnd) {
+      continue;
+    }
+
+    start = data + cursor;
+    size_t lineLength = atEnd ? filled - cursor : newline - start;
+    *line = start;
+    *length = lineLength;
+    *offset = bufferStart + cursor;
+    cursor += lineLength + !atEnd;
+    // Tolerate files with windows line endings
+    if (0 < lineLength && '\r' == start[lineLength - 1]) {
+      *length -= 1;
+    }
+    return true;
+  }
+}
+
+void LineReader::seek(CacheOffset offset) {
+  if (bufferStart <= offset && offset <= bufferStart + filled) {
+    cursor = offset - bufferStart;
+  } else {
+    bufferStart = offset;
+    filled = 0;
+    cursor = 0;
+    if (NULL != file) {
+      buffer[0] = '\0';
+    }
+  }
+}
+
+CacheOffset LineReader::tell() const {
+  return bufferStart + cursor;
+}
+
+CacheOffset LineReader::findLineStart(InputFile *file, CacheOffset pos) {
+  if (0 == pos) {
+    return 0;
+  }
+
+  // A line starts at pos if the previous byte ends a line, so start looking
+  // for a newline one byte early
+  char buf[LINE_SEARCH_SIZE];
+  CacheOffset searchPos = pos - 1;
+  while (true) {
+    size_t numRead = file->read(buf, LINE_SEARCH_SIZE, searchPos);
+    if (0 == numRead) {
+      return searchPos;
+    }
+    char *newline = reinterpret_cast<char *>(memchr(buf, '\n', numRead));
+    if (NULL != newline) {
+      return searchPos + (newline - buf) + 1;
+    }
+    searchPos += numRead;
+  }
+}
+
+CacheOffset LineReader::skipHeader(InputFile *file) {
+  return findLineStart(file, 1);
+}
@@ -0,0 +1,67 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef READERS_LINEREADER_H_
+#define READERS_LINEREADER_H_
+
+#include "../Types.h"
+#include "InputFile.h"
+
+#include <cstddef>
+#include <vector>
+
+#define LINE_READER_BUFFER_SIZE 4194304  // 2^22
+
+// Reads the lines of a file which start in a given byte range using large
+// reads, handing out pointers directly into its buffer rather than
+// copying each line. It can also read lines out of part of a file which is
+// already in memory, without copying it
+class LineReader {
+ private:
+  // NULL when reading from memory
+  InputFile *file;
+  CacheOffset end;
+  CacheOffset fileSize;
+  // File offset of data[0]
+  CacheOffset bufferStart;
+  // Either points into buffer or at memory owned by someone else
+  const char *data;
+  std::vector<char> buffer;
+  size_t filled;
+  size_t cursor;
+
+  bool fill();
+
+ public:
+  // Reads every line starting in [start, end); start should be the
+  // beginning of a line
+  LineReader(InputFile *file, CacheOffset start, CacheOffset end,
+      size_t bufferSize = LINE_READER_BUFFER_SIZE);
+  // Reads every line starting in [start, end) out of contents, which holds
+  // the file from start onwards. The byte at end must be a '\0' unless it's
+  // the start of another line. contents must outlive the reader
+  LineReader(const char *contents, CacheOffset start, CacheOffset end);
+  // data may point into buffer, which moving (but not copying) preserves
+  LineReader(LineReader &&) = default;
+  LineReader(const LineReader &) = delete;
+
+  // Points line at the next line (without its newline) and returns true, or
+  // returns false once there are no more lines in range. The line is
+  // followed by a '\n' or '\0', so it's safe to parse with strtol and co.
+  bool nextLine(const char **line, size_t *length, CacheOffset *offset);
+  // Moves to the line starting at offset, reusing the buffered data if it
+  // already covers that point in the file
+  void seek(CacheOffset offset);
+  // Offset of the line nextLine will return next
+  CacheOffset tell() const;
+
+  // Returns the offset of the first line starting at or after pos
+  static CacheOffset findLineStart(InputFile *file, CacheOffset pos);
+  // Returns the offset of the line after the header
+  static CacheOffset skipHeader(InputFile *file);
+};
+
+#endif  // READERS_LINEREADER_H_
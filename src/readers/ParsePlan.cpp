@@ -0,0 +1,132 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "ParsePlan.h"
+#include "../Types.h"
+#include "../protobuf/data.pb.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+ParsePlan::ParsePlan(const loimos::proto::CSVDefinition &csvDefinition)
+    : numUsedColumns(0), uniqueIdColumn(-1), foreignIdColumn(-1),
+    startTimeColumn(-1), durationColumn(-1) {
+  int numDataFields = 0;
+  for (int i = 0; i < csvDefinition.fields_size(); ++i) {
+    const loimos::proto::DataField &field = csvDefinition.fields(i);
+    ColumnPlan column;
+    column.slot = -1;
+
+    if (field.has_ignore()) {
+      column.kind = ParseKind::skip;
+    } else if (field.has_unique_id()) {
+      column.kind = ParseKind::unique_id;
+      uniqueIdColumn = i;
+    } else {
+      if (field.has_foreign_id()) {
+        column.kind = ParseKind::foreign_id;
+        foreignIdColumn = i;
+      } else if (field.has_start_time()) {
+        column.kind = ParseKind::start_time;
+        startTimeColumn = i;
+      } else if (field.has_duration()) {
+        column.kind = ParseKind::duration;
+        durationColumn = i;
+      } else if (field.has_int32()) {
+        column.kind = ParseKind::int32;
+      } else if (field.has_int64()) {
+        column.kind = ParseKind::int64;
+      } else if (field.has_uint32()) {
+        column.kind = ParseKind::uint32;
+      } else if (field.has_uint64()) {
+        column.kind = ParseKind::uint64;
+      } else if (field.has_double_()) {
+        column.kind = ParseKind::double_;
+      } else if (field.has_string()) {
+        column.kind = ParseKind::string;
+      } else if (field.has_bool_()) {
+        column.kind = ParseKind::bool_;
+      } else {
+        column.kind = ParseKind::category;
+      }
+      column.slot = numDataFields++;
+    }
+
+    if (ParseKind::skip != column.kind) {
+      numUsedColumns = i + 1;
+    }
+    columns.push_back(column);
+  }
+}
+
+int projectColumns(const std::unordered_set<std::string> &usedAttributes,
+    loimos::proto::CSVDefinition *csvDefinition) {
+  int numSkipped = 0;
+  for (int i = 0; i < csvDefinition->fields_size(); ++i) {
+    loimos::proto::DataField *field = csvDefinition->mutable_fields(i);
+    if (field->has_ignore() || field->has_unique_id()
+        || field->has_foreign_id() || field->has_start_time()
+        || field->has_duration()) {
+      continue;
+    }
+    if (0 == usedAttributes.count(field->field_name())) {
+      field->mutable_ignore();
+      numSkipped++;
+    }
+  }
+  return numSkipped;
+}
+
+bool parseUnsigned(const char *start, const char *end, uint64_t *value) {
+  if (start == end) {
+    return false;
+  }
+  uint64_t result = 0;
+  for (const char *c = start; c < end; ++c) {
+    unsigned digit = static_cast<unsigned char>(*c) - '0';
+    if (9 < digit || (UINT64_MAX - digit) / 10 < result) {
+      return false;
+    }
+    result = 10 * result + digit;
+  }
+  *value = result;
+  return true;
+}
+
+bool parseInteger(const char *start, const char *end, int64_t *value) {
+  bool negative = start < end && '-' == *start;
+  if (start < end && ('-' == *start || '+' == *start)) {
+    ++start;
+  }
+  uint64_t magnitude;
+  if (!parseUnsigned(start, end, &magnitude)) {
+    return false;
+  }
+
+  // The most negative value has one more unit of magnitude than the most
+  // positive one, so negate one less than the magnitude to avoid overflow
+  uint64_t limit = static_cast<uint64_t>(INT64_MAX) + (negative ? 1 : 0);
+  if (limit < magnitude) {
+    return false;
+  }
+  if (negative && 0 < magnitude) {
+    *value = -static_cast<int64_t>(magnitude - 1) - 1;
+  } else {
+    *value = static_cast<int64_t>(magnitude);
+  }
+  return true;
+}
+
+bool parseDouble(const char *start, const char *end, double *value) {
+  // Fields are always followed by a delimiter, newline, or null, so strtod
+  // can't run off the end of the buffer
+  char *parsedEnd;
+  *value = strtod(start, &parsedEnd);
+  return start != end && parsedEnd == end;
+}
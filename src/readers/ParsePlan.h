@@ -0,0 +1,113 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef READERS_PARSEPLAN_H_
+#define READERS_PARSEPLAN_H_
+
+#include "../Defs.h"
+#include "../Types.h"
+#include "../protobuf/data.pb.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// What to do with each column of a csv
+enum class ParseKind : uint8_t {
+  skip, unique_id, foreign_id, start_time, duration, int32, int64, uint32,
+  uint64, double_, string, bool_, category
+};
+
+struct ColumnPlan {
+  ParseKind kind;
+  // Index in the data vector this column is stored at, or -1 if it isn't
+  // stored there (ignored and unique id columns)
+  int slot;
+};
+
+// A CSVDefinition compiled down to a flat list of columns, so that the
+// protobuf oneof checks happen once per file rather than once per cell
+class ParsePlan {
+ public:
+  std::vector<ColumnPlan> columns;
+  // Columns past the last used one are never looked at
+  int numUsedColumns;
+  int uniqueIdColumn;
+  int foreignIdColumn;
+  int startTimeColumn;
+  int durationColumn;
+
+  explicit ParsePlan(const loimos::proto::CSVDefinition &csvDefinition);
+};
+
+// Marks every attribute column not named in usedAttributes as ignored, so
+// it's neither parsed nor stored. Id and time columns are always kept.
+// Returns the number of columns dropped
+int projectColumns(const std::unordered_set<std::string> &usedAttributes,
+    loimos::proto::CSVDefinition *csvDefinition);
+
+// Calls handleField(column, start, end) on each non-empty field in line
+// which the plan doesn't skip
+template <class F>
+void forEachField(const char *line, size_t length,
+    const ParsePlan &plan, F handleField) {
+  const char *lineEnd = line + length;
+  const char *start = line;
+  for (int c = 0; c < plan.numUsedColumns; ++c) {
+    const char *end = reinterpret_cast<const char *>(
+        memchr(start, CSV_DELIM, lineEnd - start));
+    bool lastField = NULL == end;
+    if (lastField) {
+      end = lineEnd;
+    }
+
+    const ColumnPlan &column = plan.columns[c];
+    if (ParseKind::skip != column.kind && start != end) {
+      handleField(column, start, end);
+    }
+
+    if (lastField) {
+      break;
+    }
+    start = end + 1;
+  }
+}
+
+// Parse a whole field in [start, end), returning false if it isn't a valid
+// number. Unlike the std::sto* functions, these never allocate or throw
+bool parseInteger(const char *start, const char *end, int64_t *value);
+bool parseUnsigned(const char *start, const char *end, uint64_t *value);
+bool parseDouble(const char *start, const char *end, double *value);
+
+// As above, but also returns false if the value doesn't fit in the
+// (narrower) type it's being stored as
+template <typename T>
+bool parseInteger(const char *start, const char *end, T *value) {
+  int64_t wide;
+  if (!parseInteger(start, end, &wide)
+      || wide < static_cast<int64_t>(std::numeric_limits<T>::min())
+      || static_cast<int64_t>(std::numeric_limits<T>::max()) < wide) {
+    return false;
+  }
+  *value = static_cast<T>(wide);
+  return true;
+}
+
+template <typename T>
+bool parseUnsigned(const char *start, const char *end, T *value) {
+  uint64_t wide;
+  if (!parseUnsigned(start, end, &wide)
+      || static_cast<uint64_t>(std::numeric_limits<T>::max()) < wide) {
+    return false;
+  }
+  *value = static_cast<T>(wide);
+  return true;
+}
+
+#endif  // READERS_PARSEPLAN_H_
@@ -0,0 +1,236 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../loimos.decl.h"
+#include "PopulationReader.h"
+#include "InputFile.h"
+#include "LineReader.h"
+#include "Preprocess.h"
+#include "../Types.h"
+#include "../Defs.h"
+#include "../Extern.h"
+#include "charm++.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+// Finds the range of partitions [first, end) placed on this node. Elements
+// are placed in blocks, so they're always contiguous
+void getNodePartitions(PartitionId numPartitions, PartitionId *first,
+    PartitionId *end) {
+  int firstPe = CkNodeFirst(CkMyNode());
+  int endPe = firstPe + CkNodeSize(CkMyNode());
+  *first = numPartitions;
+  *end = numPartitions;
+  for (PartitionId i = 0; i < numPartitions; ++i) {
+    int pe = getPartitionPe(i, numPartitions);
+    if (firstPe <= pe && pe < endPe) {
+      *first = std::min(*first, i);
+    } else if (endPe <= pe) {
+      *end = i;
+      break;
+    }
+  }
+  *end = std::max(*first, *end);
+}
+
+// Partitions past the end of the objects are empty, but still start (and
+// end) at the end of the csv
+Id getPartitionStart(PartitionId partitionIdx, Id numElements,
+    PartitionId numPartitions) {
+  return std::min(numElements, getFirstIndex(partitionIdx, numElements,
+        numPartitions, 0));
+}
+}  // namespace
+
+PopulationReader::PopulationReader(std::string scenarioPath_)
+    : scenarioPath(scenarioPath_), index(NULL) {
+  lock = CmiCreateLock();
+  getNodePartitions(numPeoplePartitions, &firstPeoplePartition,
+      &endPeoplePartition);
+  getNodePartitions(numLocationPartitions, &firstLocationPartition,
+      &endLocationPartition);
+}
+
+PopulationReader::~PopulationReader() {
+  delete index;
+  CmiDestroyLock(lock);
+}
+
+void PopulationReader::openIndex() {
+  // The index may still be being built when the node group is created
+  if (NULL == index) {
+    index = new ScenarioIndex(getIndexPath(scenarioPath,
+          getScenarioId(numPeople, numLocations, numDaysWithDistinctVisits)));
+  }
+}
+
+void PopulationReader::loadRegion(std::string fileName, CacheOffset start,
+    CacheOffset end, int numReaders, NodeRegion *region) {
+#if ENABLE_DEBUG >= DEBUG_PER_CHARE
+  double startTime = CkWallTimer();
+#endif
+  InputFile input(scenarioPath + fileName);
+
+  CacheOffset length = end - start;
+  region->start = start;
+  region->end = end;
+  region->data.resize(length + 1);
+  input.adviseSequential(start, end);
+  for (CacheOffset pos = 0; pos < length;) {
+    size_t toRead = std::min<CacheOffset>(NODE_READ_SIZE, length - pos);
+    size_t numRead = input.read(region->data.data() + pos, toRead,
+        start + pos);
+    if (0 == numRead) {
+      CkAbort("Error: %s ended before byte %lu\n", fileName.c_str(),
+          start + pos);
+    }
+    pos += numRead;
+  }
+  region->data[length] = '\0';
+  region->loaded = true;
+  region->numReaders = numReaders;
+
+#if ENABLE_DEBUG >= DEBUG_PER_CHARE
+  CkPrintf("  Node %d read %lu bytes of %s in %f s\n", CkMyNode(), length,
+      fileName.c_str(), CkWallTimer() - startTime);
+#endif
+}
+
+LineReader PopulationReader::getSlice(const NodeRegion &region,
+    CacheOffset start, CacheOffset end) {
+  if (start < region.start || region.end < end) {
+    CkAbort("Error: chare's data [%lu, %lu) is outside of node %d's range "
+        "[%lu, %lu)\n", start, end, CkMyNode(), region.start, region.end);
+  }
+  return LineReader(region.data.data() + (start - region.start), start, end);
+}
+
+void PopulationReader::release(NodeRegion *region) {
+  CmiLock(lock);
+  if (0 == --region->numReaders) {
+    std::vector<char>().swap(region->data);
+  }
+  CmiUnlock(lock);
+}
+
+LineReader PopulationReader::getPeopleReader(PartitionId partitionIdx) {
+  CmiLock(lock);
+  openIndex();
+  if (!people.loaded) {
+    loadRegion("people.csv",
+        index->getPersonOffset(getPartitionStart(firstPeoplePartition,
+            numPeople, numPeoplePartitions)),
+        index->getPersonOffset(getPartitionStart(endPeoplePartition,
+            numPeople, numPeoplePartitions)),
+        endPeoplePartition - firstPeoplePartition, &people);
+  }
+  LineReader reader = getSlice(people,
+      index->getPersonOffset(getPartitionStart(partitionIdx, numPeople,
+          numPeoplePartitions)),
+      index->getPersonOffset(getPartitionStart(partitionIdx + 1, numPeople,
+          numPeoplePartitions)));
+  CmiUnlock(lock);
+  return reader;
+}
+
+LineReader PopulationReader::getLocationsReader(PartitionId partitionIdx) {
+  CmiLock(lock);
+  openIndex();
+  if (!locations.loaded) {
+    loadRegion("locations.csv",
+        index->getLocationOffset(getPartitionStart(firstLocationPartition,
+            numLocations, numLocationPartitions)),
+        index->getLocationOffset(getPartitionStart(endLocationPartition,
+            numLocations, numLocationPartitions)),
+        endLocationPartition - firstLocationPartition, &locations);
+  }
+  LineReader reader = getSlice(locations,
+      index->getLocationOffset(getPartitionStart(partitionIdx, numLocations,
+          numLocationPartitions)),
+      index->getLocationOffset(getPartitionStart(partitionIdx + 1,
+          numLocations, numLocationPartitions)));
+  CmiUnlock(lock);
+  return reader;
+}
+
+LineReader PopulationReader::getVisitsReader(PartitionId partitionIdx) {
+  CmiLock(lock);
+  openIndex();
+  if (!visits.loaded) {
+    // Visits are sorted by person, so the node's visits run from its first
+    // person's first visit up to the first visit by anyone after its people
+    Id firstPerson = getPartitionStart(firstPeoplePartition, numPeople,
+        numPeoplePartitions);
+    Id endPerson = getPartitionStart(endPeoplePartition, numPeople,
+        numPeoplePartitions);
+    CacheOffset end = index->findFirstVisitOffset(endPerson,
+        numPeople - endPerson);
+    if (EMPTY_VISIT_SCHEDULE == end) {
+      end = InputFile(scenarioPath + "visits.csv").getSize();
+    }
+    CacheOffset start = index->findFirstVisitOffset(firstPerson,
+        endPerson - firstPerson);
+    if (EMPTY_VISIT_SCHEDULE == start) {
+      start = end;
+    }
+    loadRegion("visits.csv", start, end,
+        endPeoplePartition - firstPeoplePartition, &visits);
+  }
+
+  Id firstPerson = getPartitionStart(partitionIdx, numPeople,
+      numPeoplePartitions);
+  CacheOffset start = index->findFirstVisitOffset(firstPerson,
+      getNumLocalElements(numPeople, numPeoplePartitions, partitionIdx));
+  if (EMPTY_VISIT_SCHEDULE == start) {
+    start = visits.end;
+  }
+  LineReader reader = getSlice(visits, start, visits.end);
+  CmiUnlock(lock);
+  return reader;
+}
+
+void PopulationReader::getFirstVisitOffsets(PartitionId partitionIdx,
+    std::vector<CacheOffset> *offsets) {
+  Id firstPerson = getPartitionStart(partitionIdx, numPeople,
+      numPeoplePartitions);
+  Id numLocalPeople = getNumLocalElements(numPeople, numPeoplePartitions,
+      partitionIdx);
+  std::vector<CacheOffset> dayOffsets(
+      OFFSET_READ_PEOPLE * numDaysWithDistinctVisits);
+  offsets->assign(numLocalPeople, EMPTY_VISIT_SCHEDULE);
+
+  CmiLock(lock);
+  openIndex();
+  for (Id p = 0; p < numLocalPeople; p += OFFSET_READ_PEOPLE) {
+    Id numToRead = std::min<Id>(OFFSET_READ_PEOPLE, numLocalPeople - p);
+    index->readVisitOffsets(firstPerson + p, numToRead, dayOffsets.data());
+    for (Id i = 0; i < numToRead; ++i) {
+      for (int d = 0; d < numDaysWithDistinctVisits; ++d) {
+        CacheOffset offset = dayOffsets[i * numDaysWithDistinctVisits + d];
+        if (EMPTY_VISIT_SCHEDULE != offset) {
+          (*offsets)[p + i] = offset;
+          break;
+        }
+      }
+    }
+  }
+  CmiUnlock(lock);
+}
+
+void PopulationReader::releasePeople() {
+  release(&people);
+}
+
+void PopulationReader::releaseLocations() {
+  release(&locations);
+}
+
+void PopulationReader::releaseVisits() {
+  release(&visits);
+}
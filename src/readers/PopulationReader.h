@@ -0,0 +1,83 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef READERS_POPULATIONREADER_H_
+#define READERS_POPULATIONREADER_H_
+
+#include "../Types.h"
+#include "LineReader.h"
+#include "Preprocess.h"
+#include "charm++.h"
+
+#include <string>
+#include <vector>
+
+#define NODE_READ_SIZE 67108864  // 2^26
+// How many people's visit offsets to read from the index at once
+#define OFFSET_READ_PEOPLE 1024
+
+// The part of one csv which is needed by the chares on a node
+struct NodeRegion {
+  CacheOffset start;
+  CacheOffset end;
+  // Bytes [start, end) of the file followed by a null
+  std::vector<char> data;
+  bool loaded;
+  // Local chares which haven't finished reading from this region
+  int numReaders;
+
+  NodeRegion() : start(0), end(0), loaded(false), numReaders(0) {}
+};
+
+// Reads the population csvs for every chare on a node. The first local
+// chare to ask for a file causes the node's whole share of it to be read
+// with a few large reads, and every local chare then parses its own slice
+// of that buffer in place. The scenario index is also only opened once per
+// node. Chares on any PE may call in, so everything is done under a lock
+class PopulationReader : public CBase_PopulationReader {
+ private:
+  std::string scenarioPath;
+  CmiNodeLock lock;
+  ScenarioIndex *index;
+  NodeRegion people;
+  NodeRegion locations;
+  NodeRegion visits;
+  // Range of people and location chares placed on this node
+  PartitionId firstPeoplePartition;
+  PartitionId endPeoplePartition;
+  PartitionId firstLocationPartition;
+  PartitionId endLocationPartition;
+
+  void openIndex();
+  void loadRegion(std::string fileName, CacheOffset start, CacheOffset end,
+    int numReaders, NodeRegion *region);
+  LineReader getSlice(const NodeRegion &region, CacheOffset start,
+    CacheOffset end);
+  void release(NodeRegion *region);
+
+ public:
+  explicit PopulationReader(std::string scenarioPath);
+  ~PopulationReader();
+
+  // Each of these returns a reader over the lines belonging to one local
+  // chare. The reader points into the node's buffer, so the chare must call
+  // the matching release function once it's done with it
+  LineReader getPeopleReader(PartitionId partitionIdx);
+  LineReader getLocationsReader(PartitionId partitionIdx);
+  // Starts at the partition's first visit and runs past its last one, since
+  // the visits' end can only be found by parsing them
+  LineReader getVisitsReader(PartitionId partitionIdx);
+  void releasePeople();
+  void releaseLocations();
+  void releaseVisits();
+  // Looks up the offset of each of a local chare's people's first visit
+  // (EMPTY_VISIT_SCHEDULE for those without any), for chares which read
+  // their visits a day at a time rather than all at once
+  void getFirstVisitOffsets(PartitionId partitionIdx,
+    std::vector<CacheOffset> *offsets);
+};
+
+#endif  // READERS_POPULATIONREADER_H_
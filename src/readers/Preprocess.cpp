@@ -5,248 +5,556 @@
  */
 
 /**
- * This file is responsible for building a file cache pre-simulation to allow
- * direct fseeking in files rather than slow iteration. Three caches are built
- * for each of the people, locations, and activities file. The cache is
- * dependent on the files given and the number of chares
+ * This file is responsible for building a file index pre-simulation to allow
+ * direct fseeking in files rather than slow iteration. One index is built
+ * per scenario, covering the people, locations, and activities files. The
+ * index only depends on the files given, not the number of chares, so any
+ * decomposition can find its starting offsets in it.
+ *
+ * The index is built by the Preprocessor group, so that every PE scans
+ * only its own share of each file. Each PE writes the entries for the lines
+ * it scanned directly into the index file, so the results never have to be
+ * gathered in one place.
  */
 
 #include "../loimos.decl.h"
 #include "Preprocess.h"
-#include "DataReader.h"
+#include "InputFile.h"
+#include "LineReader.h"
+#include "ParsePlan.h"
 #include "../Defs.h"
 #include "../Extern.h"
 #include "charm++.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <tuple>
+#include <unordered_set>
 #include <sstream>
+#include <utility>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <google/protobuf/text_format.h>
 
-#define MAX_WRITE_SIZE 65536  // 2^16
+#define INDEX_WRITE_ENTRIES 131072  // 2^17
+#define FIRST_LINE_BUFFER_SIZE 65536  // 2^16
+#define VISIT_SEARCH_PEOPLE 1024
+#define FINGERPRINT_SAMPLES 16
+#define FINGERPRINT_SAMPLE_SIZE 4096
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
 
-/**
- * This file preprocesses a given input file.
- */
-// TODO(IanCostello): Replace getline with function that doesn't need to copy to
-//                    string object in subfunctions.
-std::tuple<Id, Id, std::string> buildCache(std::string scenarioPath, Id numPeople,
-    int numPeopleChares, Id numLocations, int numLocationChares, int numDays) {
-  std::string uniqueScenario = getScenarioId(numPeople, numPeopleChares,
-      numLocations, numLocationChares);
-  // Build person and location cache.
-  Id firstPersonIdx = buildObjectLookupCache(scenarioPath + "people.csv",
-    scenarioPath + uniqueScenario + "_people.cache", numPeople, numPeopleChares,
-    scenarioPath + "people.textproto");
-  Id firstLocationIdx = buildObjectLookupCache(scenarioPath + "locations.csv",
-    scenarioPath + uniqueScenario + "_locations.cache", numLocations,
-    numLocationChares, scenarioPath + "locations.textproto");
-  buildActivityCache(scenarioPath + "visits.csv",
-    scenarioPath + uniqueScenario + "_visits.cache", numPeople, numDays,
-    firstPersonIdx, scenarioPath + "visits.textproto");
-  return std::make_tuple(firstPersonIdx, firstLocationIdx, uniqueScenario);
-}
-
-Id buildObjectLookupCache(std::string inputPath, std::string outputPath,
-    Id numObjs, int numChares, std::string pathToCsvDefinition) {
+namespace {
+
+const char *SCENARIO_FILES[] = {"people.csv", "locations.csv", "visits.csv",
+  "people.textproto", "locations.textproto", "visits.textproto"};
+
+uint64_t hashBytes(uint64_t hash, const void *data, size_t length) {
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+// Builds a plan which only looks at the id and time columns, since those are
+// all the index needs
+ParsePlan makeIndexPlan(std::string pathToCsvDefinition) {
+  loimos::proto::CSVDefinition csvDefinition;
+  readCSVDefinition(pathToCsvDefinition, &csvDefinition);
+  projectColumns(std::unordered_set<std::string>(), &csvDefinition);
+  return ParsePlan(csvDefinition);
+}
+
+void abortOnField(CacheOffset offset, const char *line, size_t length,
+    const char *start, const char *end) {
+  CkAbort("Error at byte %lu: could not parse '%.*s' in '%.*s'\n",
+      offset, static_cast<int>(end - start), start,
+      static_cast<int>(length), line);
+}
+
+// Returns the line's unique id, aborting if it's missing or invalid
+Id parseUniqueId(const ParsePlan &plan, const char *line, size_t length,
+    CacheOffset offset) {
+  if (-1 == plan.uniqueIdColumn) {
+    CkAbort("Error: csv definition has no unique_id field\n");
+  }
+  Id id = -1;
+  bool found = false;
+  forEachField(line, length, plan,
+      [&](const ColumnPlan &column, const char *start, const char *end) {
+    if (ParseKind::unique_id != column.kind) {
+      return;
+    }
+    if (!parseInteger(start, end, &id)) {
+      abortOnField(offset, line, length, start, end);
+    }
+    found = true;
+  });
+  if (!found) {
+    CkAbort("Error at byte %lu: no id in '%.*s'\n", offset,
+        static_cast<int>(length), line);
+  }
+  return id;
+}
+
+int openIndex(std::string path) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (0 > fd) {
+    CkAbort("Error: could not open %s for writing\n", path.c_str());
+  }
+  return fd;
+}
+
+void writeAt(int fd, const void *data, size_t length, uint64_t offset) {
+  const char *bytes = reinterpret_cast<const char *>(data);
+  while (0 < length) {
+    ssize_t written = pwrite(fd, bytes, length, offset);
+    if (0 > written) {
+      CkAbort("Error: failed to write index data\n");
+    }
+    bytes += written;
+    length -= written;
+    offset += written;
+  }
+}
+
+}  // namespace
+
+Preprocessor::Preprocessor(std::string scenarioPath_, uint64_t fingerprint)
+    : scenarioPath(scenarioPath_) {
+  indexPath = getIndexPath(scenarioPath,
+      getScenarioId(numPeople, numLocations, numDaysWithDistinctVisits));
+  header = makeIndexHeader(fingerprint, numPeople, numLocations,
+      numDaysWithDistinctVisits, firstPersonIdx, firstLocationIdx);
+
+  indexObjects(scenarioPath + "people.csv", header.peopleStart, numPeople,
+    firstPersonIdx, scenarioPath + "people.textproto");
+  indexObjects(scenarioPath + "locations.csv", header.locationsStart,
+    numLocations, firstLocationIdx, scenarioPath + "locations.textproto");
+  scanActivities(scenarioPath + "visits.csv",
+    scenarioPath + "visits.textproto");
+
+  // Person-days with no visits need to be filled in with empty entries, so
+  // each PE needs to know where the entries before its own end
+  std::vector<Id> lastIndices(CkNumPes(), -1);
+  if (!visitOffsets.empty()) {
+    lastIndices[CkMyPe()] = visitOffsets.back().first;
+  }
+  CkCallback cb(CkReductionTarget(Preprocessor, WriteVisitIndex), thisProxy);
+  contribute(lastIndices, CkReduction::max_long, cb);
+}
+
+void Preprocessor::indexObjects(std::string inputPath, uint64_t sectionStart,
+    Id numObjs, Id firstIdx, std::string pathToCsvDefinition) {
   /**
    * Assumptions: (about person file)
    * -- Contigious block of IDs that are sorted.
    *
-   * Creates a mapping from char number to byte offset that the reading should
-   * commence from.
-   *
-   * Returns:
-   *    int offset of lowest contigious block.
+   * Records the byte offset of every object's line. Since the ids are
+   * contiguous, each PE's objects form a single run of entries.
    */
-  // Open activity stream..
-  std::ifstream activityStream(inputPath, std::ios_base::binary);
-  Id objPerChare = getNumElementsPerPartition(numObjs, numChares);
+  ParsePlan plan = makeIndexPlan(pathToCsvDefinition);
 
-  // Read config file.
-  loimos::proto::CSVDefinition csvDefinition;
-  std::ifstream csvConfigDefStream(pathToCsvDefinition);
-  std::string strData((std::istreambuf_iterator<char>(csvConfigDefStream)),
-      std::istreambuf_iterator<char>());
-  if (!google::protobuf::TextFormat::ParseFromString(strData, &csvDefinition)) {
-    CkAbort("Could not parse protobuf!");
-  }
-  csvConfigDefStream.close();
+  InputFile input(inputPath);
+  int indexFd = openIndex(indexPath + INDEX_TMP_SUFFIX);
+  CacheOffset begin, end;
+  std::tie(begin, end) = getPeRange(&input);
 
-  int csvLocationOfPid = -1;
-  for (int i = 0; i < csvDefinition.fields_size(); i += 1) {
-    if (csvDefinition.fields(i).has_unique_id()) {
-      csvLocationOfPid = i;
-      break;
+  LineReader reader(&input, begin, end);
+  const char *line;
+  size_t length;
+  CacheOffset offset;
+  std::vector<CacheOffset> buffer;
+  buffer.reserve(INDEX_WRITE_ENTRIES);
+  Id bufferStart = -1;
+  while (reader.nextLine(&line, &length, &offset)) {
+    if (0 == length) {
+      continue;
     }
-  }
-  assert(csvLocationOfPid != -1);
 
-  std::string line;
-  // Clear header.
-  std::getline(activityStream, line);
-  CacheOffset currentPosition = activityStream.tellg();
+    Id objIdx = parseUniqueId(plan, line, length, offset) - firstIdx;
+    if (numObjs <= objIdx) {
+      break;
+    }
+    if (-1 == bufferStart) {
+      bufferStart = objIdx;
+    }
+    if (0 > objIdx
+        || bufferStart + static_cast<Id>(buffer.size()) != objIdx) {
+      CkAbort("Error: ids in %s must be sorted and contiguous\n",
+          inputPath.c_str());
+    }
 
-  // Special case to get lowest person ID first.
-  std::getline(activityStream, line);
-  char *str = strdup(line.c_str());
-  char *tmp;
-  char *tok = strtok_r(str, ",", &tmp);
-  for (int i = 0; i < csvLocationOfPid; i++) {
-    tok = strtok_r(tmp, ",", &tmp);
+    buffer.push_back(offset);
+    if (INDEX_WRITE_ENTRIES == buffer.size()) {
+      writeAt(indexFd, buffer.data(), buffer.size() * sizeof(CacheOffset),
+          sectionStart + bufferStart * sizeof(CacheOffset));
+      bufferStart += buffer.size();
+      buffer.clear();
+    }
+  }
+  if (!buffer.empty()) {
+    writeAt(indexFd, buffer.data(), buffer.size() * sizeof(CacheOffset),
+        sectionStart + bufferStart * sizeof(CacheOffset));
   }
-  Id firstIdx = std::atoi(tok);
-  free(str);
-#if ENABLE_DEBUG >= DEBUG_VERBOSE
-  CkPrintf("  Found first id as %d\n", firstIdx);
-#endif
 
-  // Check if file cache already created.
-  std::ifstream existenceCheck(outputPath, std::ios_base::binary);
-  if (existenceCheck.good()) {
-    CkPrintf("Using existing cache.\n");
-    existenceCheck.close();
-    return firstIdx;
-
-  } else {
-    existenceCheck.close();
-    std::ofstream outputStream(outputPath, std::ios_base::binary);
-    for (int chareNum = 0; chareNum < numChares; chareNum++) {
-      // Write current offset.
-      outputStream.write(reinterpret_cast<char *>(&currentPosition),
-        sizeof(CacheOffset));
-
-      // Skip next n lines.
-      // We already read the first location on the first chare to get
-      // its id, so don't double count that line
-      Id numObjs = objPerChare - (0 == chareNum);
-      for (int i = 0; i < numObjs; i++) {
-        std::getline(activityStream, line);
-      }
-      currentPosition = activityStream.tellg();
-    }
-    outputStream.flush();
-    return firstIdx;
+  // The extra entry at the end of the section marks the end of the data
+  if (0 == CkMyPe()) {
+    CacheOffset fileSize = input.getSize();
+    writeAt(indexFd, &fileSize, sizeof(CacheOffset),
+        sectionStart + numObjs * sizeof(CacheOffset));
   }
-}
 
+  close(indexFd);
+}
 
-void buildActivityCache(std::string inputPath, std::string outputPath,
-    Id numPeople, int numDays, Id firstPersonIdx, std::string pathToCsvDefinition) {
+void Preprocessor::scanActivities(std::string inputPath,
+    std::string pathToCsvDefinition) {
   /**
    * Assumptions.
    * Stream is sorted by start time per person.
    */
-  // Check if cache already created.
-  std::ifstream existenceCheck(outputPath, std::ios_base::binary);
-  if (existenceCheck.good()) {
-    CkPrintf("Activity cache already exists.");
-    return;
+  ParsePlan plan = makeIndexPlan(pathToCsvDefinition);
+  if (-1 == plan.uniqueIdColumn || -1 == plan.startTimeColumn) {
+    CkAbort("Error: csv definition needs unique_id and start_time fields\n");
   }
 
-  std::ifstream activityStream(inputPath, std::ios_base::binary);
-  if (!activityStream) {
-    CkAbort("Error: Could not open visit data input.\n");
+  InputFile input(inputPath);
+  CacheOffset begin, end;
+  std::tie(begin, end) = getPeRange(&input);
+
+  // Note the first visit of each person-day in our range
+  LineReader reader(&input, begin, end);
+  const char *line;
+  size_t length;
+  CacheOffset offset;
+  Id lastIndex = -1;
+  while (reader.nextLine(&line, &length, &offset)) {
+    if (0 == length) {
+      continue;
+    }
+
+    Id personId = -1;
+    Time startTime = -1;
+    forEachField(line, length, plan,
+        [&](const ColumnPlan &column, const char *start, const char *end) {
+      bool valid = true;
+      if (ParseKind::unique_id == column.kind) {
+        valid = parseInteger(start, end, &personId);
+      } else if (ParseKind::start_time == column.kind) {
+        valid = parseInteger(start, end, &startTime);
+      }
+      if (!valid) {
+        abortOnField(offset, line, length, start, end);
+      }
+    });
+    if (0 > personId || 0 > startTime) {
+      CkAbort("Error at byte %lu: no id or start time in '%.*s'\n", offset,
+          static_cast<int>(length), line);
+    }
+    Id personIdx = personId - firstPersonIdx;
+    int day = getDay(startTime);
+    if (0 > personIdx || numPeople <= personIdx) {
+      CkAbort("Error: visit for unknown person " ID_PRINT_TYPE "\n",
+          personIdx + firstPersonIdx);
+    }
+    // Visits after the last distinct day are never read
+    if (numDaysWithDistinctVisits <= day) {
+      continue;
+    }
+
+    Id index = numDaysWithDistinctVisits * personIdx + day;
+    if (index < lastIndex) {
+      CkAbort("Error: visits must be sorted by person and start time\n");
+    }
+    if (index != lastIndex) {
+      visitOffsets.emplace_back(index, offset);
+      lastIndex = index;
+    }
   }
+}
 
-  // Read config file.
-  loimos::proto::CSVDefinition csvDefinition;
-  std::ifstream csvConfigDefStream(pathToCsvDefinition);
-  std::string strData((std::istreambuf_iterator<char>(csvConfigDefStream)),
-      std::istreambuf_iterator<char>());
-  if (!google::protobuf::TextFormat::ParseFromString(strData, &csvDefinition)) {
-    CkAbort("Could not parse protobuf!");
+void Preprocessor::WriteVisitIndex(int numPes, Id *lastIndices) {
+  Id totalEntries = static_cast<Id>(numPeople) * numDaysWithDistinctVisits;
+  int thisPe = CkMyPe();
+
+  // A person-day which starts on an earlier PE may continue into our range,
+  // in which case our first entry for it isn't really the first
+  Id start = 0;
+  for (int pe = 0; pe < thisPe; ++pe) {
+    start = std::max(start, lastIndices[pe] + 1);
+  }
+  size_t firstOffset = 0;
+  while (firstOffset < visitOffsets.size()
+      && visitOffsets[firstOffset].first < start) {
+    if (0 != firstOffset || visitOffsets[firstOffset].first + 1 < start) {
+      CkAbort("Error: visits must be sorted by person and start time\n");
+    }
+    ++firstOffset;
+  }
+
+  // Each PE fills in everything from the end of the previous PE's entries
+  // through its own last entry, and whichever PE has the last entry overall
+  // fills in the rest of the section
+  Id stop = start;
+  if (firstOffset < visitOffsets.size()) {
+    stop = visitOffsets.back().first + 1;
+    bool isLast = true;
+    for (int pe = thisPe + 1; pe < numPes; ++pe) {
+      isLast &= lastIndices[pe] < stop;
+    }
+    if (isLast) {
+      stop = totalEntries;
+    }
+  } else if (0 == thisPe) {
+    bool noVisits = true;
+    for (int pe = 0; pe < numPes; ++pe) {
+      noVisits &= -1 == lastIndices[pe];
+    }
+    if (noVisits) {
+      stop = totalEntries;
+    }
   }
-  csvConfigDefStream.close();
-
-  // Create position vector for each person.
-  std::size_t totalDataSize = numPeople * numDaysWithDistinctVisits
-    * sizeof(CacheOffset);
-  CacheOffset *elements = reinterpret_cast<CacheOffset *>(malloc(totalDataSize));
-  if (NULL == elements) {
-    CkAbort("Failed to malloc enoough memory for preprocessing.\n");
-  }
-  memset(elements, 0xFF, totalDataSize);
-
-  // Various initialization.
-  std::string line;
-  // Clear header.
-  std::getline(activityStream, line);
-  CacheOffset current_position = activityStream.tellg();
-  Id lastPerson = -1;
-  Time lastTime = -1;
-  Id nextPerson = 0;
-  Time nextTime = 0;
-  Time nextTimeSec = 0;
-  Id locationId = -1;
-  Time duration = -1;
-  Id totalVisits = 0;
-  // For better looping efficiency simulate one break of inner loop to start.
-  std::tie(nextPerson, locationId, nextTime, duration) =
-    DataReader<>::parseActivityStream(&activityStream, &csvDefinition, NULL);
-  nextTimeSec = nextTime;
-  nextTime = getDay(nextTime);
-
-  // Loop over the entire activity file and note boundaries on people and days
-  Id numVisits = 0;
-  while (!activityStream.eof()) {
-    // CkPrintf("Person %d has %d visits on day %d (next byte is %u)\n",
-    //   lastPerson, numVisits, lastTime, current_position);
-
-    // Get details of new entry.
-    lastPerson = nextPerson;
-    lastTime = nextTime;
-    numVisits = 0;
-
-    CacheOffset index =
-      numDaysWithDistinctVisits * (lastPerson - firstPersonIdx) + lastTime;
-    if (numPeople * numDaysWithDistinctVisits > index) {
-      elements[index] = current_position;
+
+  int indexFd = openIndex(indexPath + INDEX_TMP_SUFFIX);
+  std::vector<CacheOffset> buffer;
+  buffer.reserve(INDEX_WRITE_ENTRIES);
+  Id bufferStart = start;
+  size_t next = firstOffset;
+  for (Id index = start; index < stop; ++index) {
+    if (next < visitOffsets.size() && visitOffsets[next].first == index) {
+      buffer.push_back(visitOffsets[next].second);
+      ++next;
     } else {
-      CkAbort("    Failed to write %lu bytes at %lu\n", current_position, index);
+      buffer.push_back(EMPTY_VISIT_SCHEDULE);
+    }
+
+    if (INDEX_WRITE_ENTRIES == buffer.size() || index + 1 == stop) {
+      writeAt(indexFd, buffer.data(), buffer.size() * sizeof(CacheOffset),
+          header.visitsStart + bufferStart * sizeof(CacheOffset));
+      bufferStart += buffer.size();
+      buffer.clear();
     }
-    // if (0 == lastPerson % 10000) {
-    //   CkPrintf("  Setting person %d to read from %u on day %d\n",
-    //       lastPerson, current_position, lastTime);
-    //   CkPrintf("  Person %d on day %d first visit (%u): %d to %d, at loc %d\n",
-    //       lastPerson, lastTime, current_position, nextTimeSec,
-    //       nextTimeSec + duration, locationId);
-    // }
+  }
 
-    // Scan until the next boundary.
-    while (!activityStream.eof()
-        && lastTime == nextTime
-        && lastPerson == nextPerson) {
-      current_position = activityStream.tellg();
-      std::tie(nextPerson, locationId, nextTime, duration) =
-        DataReader<>::parseActivityStream(&activityStream,
-            &csvDefinition, NULL);
+  // The header goes in last, although nothing reads it before Main moves
+  // the finished index into place
+  if (0 == thisPe) {
+    writeAt(indexFd, &header, sizeof(IndexHeader), 0);
+  }
+  close(indexFd);
+  std::vector<std::pair<CacheOffset, CacheOffset> >().swap(visitOffsets);
+
+  contribute(CkCallback(CkReductionTarget(Main, IndexBuilt), mainProxy));
+}
 
-      nextTime = getDay(nextTime);
-      numVisits++;
-      totalVisits++;
+ScenarioIndex::ScenarioIndex(std::string path)
+    : stream(path, std::ios_base::binary) {
+  if (!stream) {
+    CkAbort("Error: could not open scenario index %s\n", path.c_str());
+  }
+  stream.read(reinterpret_cast<char *>(&header), sizeof(IndexHeader));
+}
+
+const IndexHeader &ScenarioIndex::getHeader() const {
+  return header;
+}
+
+CacheOffset ScenarioIndex::readEntry(uint64_t position) {
+  CacheOffset entry;
+  stream.seekg(position);
+  stream.read(reinterpret_cast<char *>(&entry), sizeof(CacheOffset));
+  return entry;
+}
+
+CacheOffset ScenarioIndex::getPersonOffset(Id personIdx) {
+  return readEntry(header.peopleStart + personIdx * sizeof(CacheOffset));
+}
+
+CacheOffset ScenarioIndex::getLocationOffset(Id locationIdx) {
+  return readEntry(header.locationsStart + locationIdx * sizeof(CacheOffset));
+}
+
+void ScenarioIndex::readVisitOffsets(Id firstPerson, Id numPeople,
+    CacheOffset *offsets) {
+  stream.seekg(header.visitsStart
+      + firstPerson * header.numDays * sizeof(CacheOffset));
+  stream.read(reinterpret_cast<char *>(offsets),
+      numPeople * header.numDays * sizeof(CacheOffset));
+}
+
+CacheOffset ScenarioIndex::findFirstVisitOffset(Id firstPerson,
+    Id numPeople) {
+  // Entries are in file order, so the first non-empty one is the earliest.
+  // Most people have visits, so this rarely needs more than one chunk
+  std::vector<CacheOffset> offsets(VISIT_SEARCH_PEOPLE * header.numDays);
+  for (Id p = 0; p < numPeople; p += VISIT_SEARCH_PEOPLE) {
+    Id numToRead = std::min<Id>(VISIT_SEARCH_PEOPLE, numPeople - p);
+    readVisitOffsets(firstPerson + p, numToRead, offsets.data());
+    for (Id i = 0; i < numToRead * header.numDays; ++i) {
+      if (EMPTY_VISIT_SCHEDULE != offsets[i]) {
+        return offsets[i];
+      }
     }
   }
-  CkPrintf("Parsed a total of %d visits\n", totalVisits);
+  return EMPTY_VISIT_SCHEDULE;
+}
 
-  // Output
-  std::ofstream outputStream(outputPath, std::ios::out | std::ios::binary);
-  outputStream.write(reinterpret_cast<const char *>(elements), totalDataSize);
-  outputStream.close();
+bool isValidIndex(std::string indexPath, uint64_t fingerprint,
+    IndexHeader *header) {
+  std::ifstream stream(indexPath, std::ios_base::binary);
+  if (!stream.read(reinterpret_cast<char *>(header), sizeof(IndexHeader))) {
+    return false;
+  }
+  return INDEX_MAGIC == header->magic && INDEX_VERSION == header->version
+    && fingerprint == header->fingerprint
+    && numPeople == header->numPeople
+    && numLocations == header->numLocations
+    && numDaysWithDistinctVisits == static_cast<int>(header->numDays);
+}
+
+void finishIndex(std::string indexPath) {
+  if (0 != rename((indexPath + INDEX_TMP_SUFFIX).c_str(), indexPath.c_str())) {
+    CkAbort("Error: could not move %s into place\n", indexPath.c_str());
+  }
+}
+
+std::tuple<Id, Id> getFirstIndices(std::string scenarioPath) {
+  Id firstPersonIdx = getFirstIdx(scenarioPath + "people.csv",
+      scenarioPath + "people.textproto");
+  Id firstLocationIdx = getFirstIdx(scenarioPath + "locations.csv",
+      scenarioPath + "locations.textproto");
+  return std::make_tuple(firstPersonIdx, firstLocationIdx);
+}
+
+uint64_t getScenarioFingerprint(std::string scenarioPath) {
+  std::vector<std::string> paths;
+  for (const char *file : SCENARIO_FILES) {
+    paths.push_back(scenarioPath + file);
+  }
+  return getFilesFingerprint(paths);
+}
+
+uint64_t getFilesFingerprint(const std::vector<std::string> &paths) {
+  // Hashing whole files would cost as much as indexing them, so only the
+  // sizes, modification times and a spread of small samples from each file
+  // are used. The times catch edits which keep a file's size and miss every
+  // sample, at the cost of a rebuild whenever a file is touched
+  uint64_t hash = FNV_OFFSET_BASIS;
+  std::vector<char> sample(FINGERPRINT_SAMPLE_SIZE);
+  for (const std::string &file : paths) {
+    // Compressed files are hashed as they are on disk
+    std::string path = InputFile::resolvePath(file);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (0 > fd) {
+      CkAbort("Error: could not open %s\n", path.c_str());
+    }
+    struct stat info;
+    fstat(fd, &info);
+    CacheOffset fileSize = info.st_size;
+    hash = hashBytes(hash, &fileSize, sizeof(CacheOffset));
+    int64_t modifiedTime = static_cast<int64_t>(info.st_mtime);
+    hash = hashBytes(hash, &modifiedTime, sizeof(int64_t));
+
+    CacheOffset lastSample = fileSize - std::min<CacheOffset>(fileSize,
+        FINGERPRINT_SAMPLE_SIZE);
+    for (int i = 0; i < FINGERPRINT_SAMPLES; ++i) {
+      ssize_t numRead = pread(fd, sample.data(), FINGERPRINT_SAMPLE_SIZE,
+          lastSample * i / (FINGERPRINT_SAMPLES - 1));
+      if (0 < numRead) {
+        hash = hashBytes(hash, sample.data(), numRead);
+      }
+    }
+    close(fd);
+  }
+  return hash;
+}
+
+IndexHeader makeIndexHeader(uint64_t fingerprint, Id numPeople,
+    Id numLocations, int numDays, Id firstPersonIdx, Id firstLocationIdx) {
+  IndexHeader header;
+  memset(&header, 0, sizeof(IndexHeader));
+  header.magic = INDEX_MAGIC;
+  header.version = INDEX_VERSION;
+  header.numDays = numDays;
+  header.fingerprint = fingerprint;
+  header.numPeople = numPeople;
+  header.numLocations = numLocations;
+  header.firstPersonIdx = firstPersonIdx;
+  header.firstLocationIdx = firstLocationIdx;
+  header.peopleStart = sizeof(IndexHeader);
+  header.locationsStart = header.peopleStart
+    + (numPeople + 1) * sizeof(CacheOffset);
+  header.visitsStart = header.locationsStart
+    + (numLocations + 1) * sizeof(CacheOffset);
+  return header;
+}
+
+void readCSVDefinition(std::string path,
+    loimos::proto::CSVDefinition *csvDefinition) {
+  std::ifstream stream(path);
+  if (!stream) {
+    CkAbort("Could not open %s\n", path.c_str());
+  }
+  std::string strData((std::istreambuf_iterator<char>(stream)),
+      std::istreambuf_iterator<char>());
+  if (!google::protobuf::TextFormat::ParseFromString(strData, csvDefinition)) {
+    CkAbort("Could not parse protobuf!");
+  }
+}
+
+Id getFirstIdx(std::string inputPath, std::string pathToCsvDefinition) {
+  ParsePlan plan = makeIndexPlan(pathToCsvDefinition);
+
+  // Only the first line after the header is needed
+  InputFile input(inputPath);
+  CacheOffset dataStart = LineReader::skipHeader(&input);
+  LineReader reader(&input, dataStart, input.getSize(),
+      FIRST_LINE_BUFFER_SIZE);
+  const char *line;
+  size_t length;
+  CacheOffset offset;
+  if (!reader.nextLine(&line, &length, &offset)) {
+    CkAbort("Error: %s has no data\n", inputPath.c_str());
+  }
+  Id firstIdx = parseUniqueId(plan, line, length, offset);
+#if ENABLE_DEBUG >= DEBUG_VERBOSE
+  CkPrintf("  Found first id as " ID_PRINT_TYPE "\n", firstIdx);
+#endif
+  return firstIdx;
+}
+
+std::tuple<CacheOffset, CacheOffset> getPeRange(InputFile *input) {
+  CacheOffset dataStart = LineReader::skipHeader(input);
+  CacheOffset dataSize = input->getSize() - dataStart;
+  int numPes = CkNumPes();
+  int thisPe = CkMyPe();
+
+  // Neighbouring PEs snap the same byte to the same line start, so every
+  // line is scanned exactly once
+  CacheOffset begin = dataStart + dataSize * thisPe / numPes;
+  CacheOffset end = dataStart + dataSize * (thisPe + 1) / numPes;
+  return std::make_tuple(LineReader::findLineStart(input, begin),
+      LineReader::findLineStart(input, end));
 }
 
 int getDay(Time timeInSeconds) {
   return timeInSeconds / DAY_LENGTH;
 }
 
-std::string getScenarioId(Id numPeople, int numPeopleChares, Id numLocations,
-    int numLocationChares) {
+std::string getScenarioId(Id numPeople, Id numLocations, int numDays) {
   std::ostringstream oss;
-  oss << numPeople << "-" << numPeopleChares << "_" << numLocations
-    << "-" << numLocationChares;
+  oss << numPeople << "_" << numLocations << "_" << numDays;
   return oss.str();
 }
 
+std::string getIndexPath(std::string scenarioPath, std::string scenarioId) {
+  return scenarioPath + scenarioId + INDEX_SUFFIX;
+}
@@ -8,21 +8,112 @@
 #define READERS_PREPROCESS_H_
 
 #include "../Types.h"
+#include "../protobuf/data.pb.h"
+#include "InputFile.h"
 
+#include <cstdint>
+#include <fstream>
 #include <tuple>
 #include <string>
+#include <utility>
+#include <vector>
 
-// Main entry point.
-std::tuple<Id, Id, std::string> buildCache(std::string scenarioPath, Id numPeople,
-  int peopleChares, Id numLocations, int numLocationChares, int numDays);
+// Identifies scenario index files ("LOIMOIDX" in little endian)
+#define INDEX_MAGIC 0x5844494f4d494f4cULL
+// Bump this whenever the index layout changes so stale indices get rebuilt
+#define INDEX_VERSION 1
+#define INDEX_SUFFIX ".index"
+// Indices are written under this suffix and only renamed once every PE has
+// finished, so an interrupted run never leaves a partial index behind
+#define INDEX_TMP_SUFFIX ".tmp"
+
+// A scenario's index doesn't depend on how the people and locations are
+// split up between chares. It holds the byte offset of every person and
+// location, so any partitioning can find where its first object starts,
+// followed by the offset of each person's first visit on each day
+// (EMPTY_VISIT_SCHEDULE if there are none)
+struct IndexHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t numDays;
+  // Taken from the scenario's files (see getFilesFingerprint), to catch
+  // data changing underneath an existing index
+  uint64_t fingerprint;
+  Id numPeople;
+  Id numLocations;
+  Id firstPersonIdx;
+  Id firstLocationIdx;
+  // Positions of each section in the index file. The people and location
+  // sections each have one extra entry at the end holding the csv's size
+  uint64_t peopleStart;
+  uint64_t locationsStart;
+  uint64_t visitsStart;
+};
+
+// Builds the scenario index in parallel. Each PE scans an equal share of
+// the bytes in each file (snapped to line boundaries) and writes its entries
+// directly into the shared index file
+class Preprocessor : public CBase_Preprocessor {
+ private:
+  std::string scenarioPath;
+  std::string indexPath;
+  IndexHeader header;
+  // (index entry, byte offset) of the first visit of each person-day which
+  // starts in this PE's range, in the order they appear in the file
+  std::vector<std::pair<CacheOffset, CacheOffset> > visitOffsets;
+
+  void indexObjects(std::string inputPath, uint64_t sectionStart, Id numObjs,
+    Id firstIdx, std::string pathToCsvDefinition);
+  void scanActivities(std::string inputPath, std::string pathToCsvDefinition);
+
+ public:
+  Preprocessor(std::string scenarioPath, uint64_t fingerprint);
+  void WriteVisitIndex(int numPes, Id *lastIndices);
+};
+
+// Provides lookups into a complete scenario index
+class ScenarioIndex {
+ private:
+  std::ifstream stream;
+  IndexHeader header;
+
+  CacheOffset readEntry(uint64_t position);
+
+ public:
+  explicit ScenarioIndex(std::string path);
+
+  const IndexHeader &getHeader() const;
+  // Indices are relative to the first person or location; passing the
+  // number of people or locations gives the end of the csv
+  CacheOffset getPersonOffset(Id personIdx);
+  CacheOffset getLocationOffset(Id locationIdx);
+  // Reads numDays offsets for each of numPeople people, starting with
+  // firstPerson
+  void readVisitOffsets(Id firstPerson, Id numPeople, CacheOffset *offsets);
+  // Offset of the first visit by any of numPeople people starting with
+  // firstPerson, or EMPTY_VISIT_SCHEDULE if none of them have visits
+  CacheOffset findFirstVisitOffset(Id firstPerson, Id numPeople);
+};
+
+// Main entry points.
+bool isValidIndex(std::string indexPath, uint64_t fingerprint,
+  IndexHeader *header);
+void finishIndex(std::string indexPath);
+std::tuple<Id, Id> getFirstIndices(std::string scenarioPath);
+uint64_t getScenarioFingerprint(std::string scenarioPath);
+// Cheap stand-in for a hash of the files' contents, which changes whenever
+// any of them are modified
+uint64_t getFilesFingerprint(const std::vector<std::string> &paths);
 
 // Helper functions.
-Id buildObjectLookupCache(std::string inputPath, std::string outputPath, Id numObjs,
-  int numChares, std::string pathToCsvDefinition);
-void buildActivityCache(std::string inputPath, std::string outputPath, Id numPeople,
-  int numDays, Id firstPersonIdx, std::string pathToCsvDefinition);
+IndexHeader makeIndexHeader(uint64_t fingerprint, Id numPeople,
+  Id numLocations, int numDays, Id firstPersonIdx, Id firstLocationIdx);
+void readCSVDefinition(std::string path,
+  loimos::proto::CSVDefinition *csvDefinition);
+Id getFirstIdx(std::string inputPath, std::string pathToCsvDefinition);
+std::tuple<CacheOffset, CacheOffset> getPeRange(InputFile *input);
 int getDay(Time timeInSeconds);
-std::string getScenarioId(Id numPeople, int numPeopleChares, Id numLocations,
-  int numLocationChares);
+std::string getScenarioId(Id numPeople, Id numLocations, int numDays);
+std::string getIndexPath(std::string scenarioPath, std::string scenarioId);
 
 #endif  // READERS_PREPROCESS_H_
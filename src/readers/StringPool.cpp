@@ -0,0 +1,64 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "StringPool.h"
+#include "charm++.h"
+
+#include <cstddef>
+#include <limits>
+#include <string>
+
+StringPool::StringPool() {
+  lock = CmiCreateLock();
+}
+
+StringPool::~StringPool() {
+  CmiDestroyLock(lock);
+}
+
+StringId StringPool::intern(const char *start, size_t length) {
+  return intern(std::string(start, length));
+}
+
+StringId StringPool::intern(const std::string &str) {
+  CmiLock(lock);
+  auto it = ids.find(str);
+  StringId id;
+  if (ids.end() != it) {
+    id = it->second;
+  } else {
+    if (std::numeric_limits<StringId>::max() == strings.size()) {
+      CkAbort("Error: too many distinct string attribute values\n");
+    }
+    id = static_cast<StringId>(strings.size());
+    strings.push_back(&ids.emplace(str, id).first->first);
+  }
+  CmiUnlock(lock);
+  return id;
+}
+
+const std::string &StringPool::get(StringId id) {
+  CmiLock(lock);
+  if (strings.size() <= id) {
+    CkAbort("Error: invalid string handle %u\n", id);
+  }
+  const std::string *str = strings[id];
+  CmiUnlock(lock);
+  return *str;
+}
+
+size_t StringPool::size() {
+  CmiLock(lock);
+  size_t numStrings = strings.size();
+  CmiUnlock(lock);
+  return numStrings;
+}
+
+StringPool &StringPool::getNodePool() {
+  // Every PE in a process shares its statics, so this is one pool per node
+  static StringPool pool;
+  return pool;
+}
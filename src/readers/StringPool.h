@@ -0,0 +1,51 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef READERS_STRINGPOOL_H_
+#define READERS_STRINGPOOL_H_
+
+#include "charm++.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Handle for a string stored in the node's pool
+typedef uint32_t StringId;
+
+// Holds one copy of each distinct string attribute value on a node, so
+// objects only need to store a 32-bit handle. Handles are only meaningful on
+// the node which created them, so objects must convert their strings back
+// into text when migrating (see AttributeStore::pup). Chares on any PE
+// may call in, so everything is done under a lock
+class StringPool {
+ private:
+  // Each string is only stored as a key in ids; strings points at those
+  // keys, which never move once inserted
+  std::unordered_map<std::string, StringId> ids;
+  std::vector<const std::string *> strings;
+  CmiNodeLock lock;
+
+  StringPool();
+  ~StringPool();
+
+ public:
+  StringPool(const StringPool &) = delete;
+  StringPool &operator=(const StringPool &) = delete;
+
+  // Returns the handle for the given string, adding it if needed
+  StringId intern(const char *start, size_t length);
+  StringId intern(const std::string &str);
+  const std::string &get(StringId id);
+  size_t size();
+
+  // Returns this node's pool
+  static StringPool &getNodePool();
+};
+
+#endif  // READERS_STRINGPOOL_H_
@@ -0,0 +1,191 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../loimos.decl.h"
+#include "../Types.h"
+#include "../readers/BinaryFormat.h"
+#include "../protobuf/data.pb.h"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <google/protobuf/text_format.h>
+
+/** Tests converting csvs to the binary format and reading them back. */
+
+namespace {
+
+class BinaryFormatTest : public ::testing::Test {
+ protected:
+  std::string directory;
+
+  virtual void SetUp() {
+    char pattern[] = "/tmp/loimos_binary_test_XXXXXX";
+    ASSERT_NE(mkdtemp(pattern), nullptr);
+    directory = std::string(pattern) + "/";
+  }
+
+  virtual void TearDown() {
+    std::system(("rm -rf " + directory).c_str());
+  }
+
+  std::string writeFile(std::string name, std::string contents) {
+    std::string path = directory + name;
+    std::ofstream out(path);
+    out << contents;
+    return path;
+  }
+
+  std::string convert(std::string name, std::string csv,
+      std::string definition, Id numGroups, Id groupFirstIdx) {
+    loimos::proto::CSVDefinition csvDefinition;
+    EXPECT_TRUE(google::protobuf::TextFormat::ParseFromString(definition,
+          &csvDefinition));
+    std::string csvPath = writeFile(name + ".csv", csv);
+    std::string definitionPath = writeFile(name + ".textproto", definition);
+    std::string binaryPath = directory + name + BINARY_FILE_SUFFIX;
+    convertToBinary(csvPath, binaryPath, csvDefinition, numGroups,
+        groupFirstIdx, getSourceFingerprint(csvPath, definitionPath));
+    return binaryPath;
+  }
+};
+
+const char PEOPLE_DEFINITION[] =
+  "fields { field_name: 'pid' unique_id {} }\n"
+  "fields { field_name: 'age' int32 {} }\n"
+  "fields { field_name: 'county' string {} default_string: 'unknown' }\n"
+  "fields { field_name: 'notes' ignore {} }\n"
+  "fields { field_name: 'susceptibility' double {} }\n";
+
+const char VISITS_DEFINITION[] =
+  "fields { field_name: 'pid' unique_id {} }\n"
+  "fields { field_name: 'lid' foreign_id {} }\n"
+  "fields { field_name: 'start_time' start_time {} }\n"
+  "fields { field_name: 'duration' duration {} }\n";
+
+TEST_F(BinaryFormatTest, RoundTripsColumns) {
+  std::string path = convert("people",
+      "pid,age,county,notes,susceptibility\n"
+      "7,30,Albemarle,a,0.5\n"
+      "8,-4,,b,1.25\n"
+      "9,61,Albemarle,c,0\n",
+      PEOPLE_DEFINITION, 0, 0);
+  BinaryReader reader(path);
+
+  const BinaryHeader &header = reader.getHeader();
+  EXPECT_EQ(header.numRows, 3);
+  EXPECT_EQ(header.firstIdx, 7);
+  EXPECT_EQ(header.numGroups, 0);
+  // The ignored column isn't stored at all
+  EXPECT_EQ(reader.getNumColumns(), 4);
+  EXPECT_EQ(reader.getColumnIndex("notes"), -1);
+
+  int idColumn = reader.getColumnIndex(ColumnRole::unique_id);
+  ASSERT_NE(idColumn, -1);
+  const Id *ids = reinterpret_cast<const Id *>(
+      reader.mapColumn(idColumn, 0, 3));
+  EXPECT_EQ(ids[0], 7);
+  EXPECT_EQ(ids[2], 9);
+
+  int ageColumn = reader.getColumnIndex("age");
+  ASSERT_NE(ageColumn, -1);
+  EXPECT_EQ(reader.getColumn(ageColumn).dataType, DataTypes::int32_);
+  const int32_t *ages = reinterpret_cast<const int32_t *>(
+      reader.mapColumn(ageColumn, 1, 2));
+  EXPECT_EQ(ages[0], -4);
+  EXPECT_EQ(ages[1], 61);
+
+  int susceptibilityColumn = reader.getColumnIndex("susceptibility");
+  const double *susceptibilities = reinterpret_cast<const double *>(
+      reader.mapColumn(susceptibilityColumn, 0, 3));
+  EXPECT_DOUBLE_EQ(susceptibilities[1], 1.25);
+
+  // Repeated strings are only stored once, and empty fields get the default
+  int countyColumn = reader.getColumnIndex("county");
+  ASSERT_NE(countyColumn, -1);
+  EXPECT_EQ(reader.getColumn(countyColumn).dataType, DataTypes::string_);
+  EXPECT_EQ(header.numStrings, 2);
+  const uint32_t *counties = reinterpret_cast<const uint32_t *>(
+      reader.mapColumn(countyColumn, 0, 3));
+  EXPECT_EQ(counties[0], counties[2]);
+  EXPECT_EQ(reader.getString(counties[0]), "Albemarle");
+  EXPECT_EQ(reader.getString(counties[1]), "unknown");
+}
+
+TEST_F(BinaryFormatTest, GroupsRowsByUniqueId) {
+  // Person 12 has no visits and person 14 comes after the last row
+  std::string path = convert("visits",
+      "pid,lid,start_time,duration\n"
+      "10,3,0,3600\n"
+      "10,5,3600,100\n"
+      "11,3,86400,7200\n"
+      "13,4,200,300\n",
+      VISITS_DEFINITION, 5, 10);
+  BinaryReader reader(path);
+
+  const BinaryHeader &header = reader.getHeader();
+  EXPECT_EQ(header.numRows, 4);
+  EXPECT_EQ(header.numGroups, 5);
+  EXPECT_EQ(header.groupFirstIdx, 10);
+
+  const uint64_t *offsets = reader.mapGroupOffsets(0, 5);
+  uint64_t expected[] = {0, 2, 3, 3, 4, 4};
+  for (int p = 0; p <= 5; ++p) {
+    EXPECT_EQ(offsets[p], expected[p]) << "group " << p;
+  }
+  // A partition starting partway through reads its slice of the same table
+  const uint64_t *partOffsets = reader.mapGroupOffsets(2, 2);
+  EXPECT_EQ(partOffsets[0], 3);
+  EXPECT_EQ(partOffsets[2], 4);
+
+  int startColumn = reader.getColumnIndex(ColumnRole::start_time);
+  int locationColumn = reader.getColumnIndex(ColumnRole::foreign_id);
+  ASSERT_NE(startColumn, -1);
+  ASSERT_NE(locationColumn, -1);
+  const Time *starts = reinterpret_cast<const Time *>(
+      reader.mapColumn(startColumn, offsets[1], 1));
+  const Id *locations = reinterpret_cast<const Id *>(
+      reader.mapColumn(locationColumn, offsets[3], 1));
+  EXPECT_EQ(starts[0], 86400);
+  EXPECT_EQ(locations[0], 4);
+}
+
+TEST_F(BinaryFormatTest, RejectsMalformedCells) {
+  // Rather than storing 12 or 0 for every later run
+  EXPECT_DEATH(convert("visits",
+        "pid,lid,start_time,duration\n"
+        "0,1,12x,60\n",
+        VISITS_DEFINITION, 1, 0),
+      "byte 28 of .*visits.csv: could not parse '12x'");
+  // Durations are 32-bit, so this can't be stored without truncating it
+  EXPECT_DEATH(convert("visits",
+        "pid,lid,start_time,duration\n"
+        "0,1,0,60\n"
+        "0,2,60,4294967296\n",
+        VISITS_DEFINITION, 1, 0),
+      "byte 37 of .*visits.csv: could not parse '4294967296'");
+  EXPECT_DEATH(convert("visits",
+        "pid,lid,start_time,duration\n"
+        ",1,0,60\n",
+        VISITS_DEFINITION, 1, 0),
+      "missing unique id");
+}
+
+TEST_F(BinaryFormatTest, ChecksSourceFingerprint) {
+  std::string path = convert("visits",
+      "pid,lid,start_time,duration\n"
+      "0,1,0,60\n",
+      VISITS_DEFINITION, 1, 0);
+  uint64_t fingerprint = getSourceFingerprint(directory + "visits.csv",
+      directory + "visits.textproto");
+  EXPECT_TRUE(isValidBinaryFile(path, fingerprint));
+  EXPECT_FALSE(isValidBinaryFile(path, fingerprint + 1));
+  EXPECT_FALSE(isValidBinaryFile(directory + "missing.bin", fingerprint));
+}
+
+}  // namespace
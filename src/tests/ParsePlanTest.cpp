@@ -0,0 +1,177 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../loimos.decl.h"
+#include "../readers/ParsePlan.h"
+#include "../protobuf/data.pb.h"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <google/protobuf/text_format.h>
+
+/** Tests the compiled csv parser. */
+
+namespace {
+
+const char DEFINITION[] =
+  "fields { field_name: 'pid' unique_id {} }\n"
+  "fields { field_name: 'age' int32 {} }\n"
+  "fields { field_name: 'notes' ignore {} }\n"
+  "fields { field_name: 'weight' double {} }\n"
+  "fields { field_name: 'unused' ignore {} }\n";
+
+template <typename T>
+bool parse(const char *str, T *value) {
+  return parseInteger(str, str + strlen(str), value);
+}
+
+template <typename T>
+bool parseU(const char *str, T *value) {
+  return parseUnsigned(str, str + strlen(str), value);
+}
+
+class ParsePlanTest : public ::testing::Test {
+ protected:
+  loimos::proto::CSVDefinition csvDefinition;
+
+  virtual void SetUp() {
+    ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(DEFINITION,
+          &csvDefinition));
+  }
+
+  // Returns each field passed to forEachField along with its kind
+  std::vector<std::pair<ParseKind, std::string> > split(std::string line) {
+    ParsePlan plan(csvDefinition);
+    std::vector<std::pair<ParseKind, std::string> > fields;
+    forEachField(line.c_str(), line.size(), plan,
+        [&](const ColumnPlan &column, const char *start, const char *end) {
+      fields.emplace_back(column.kind, std::string(start, end));
+    });
+    return fields;
+  }
+};
+
+TEST(ParseIntegerTest, ParsesSigns) {
+  int64_t value;
+  EXPECT_TRUE(parse("42", &value));
+  EXPECT_EQ(value, 42);
+  EXPECT_TRUE(parse("-42", &value));
+  EXPECT_EQ(value, -42);
+  EXPECT_TRUE(parse("+42", &value));
+  EXPECT_EQ(value, 42);
+  EXPECT_TRUE(parse("-0", &value));
+  EXPECT_EQ(value, 0);
+}
+
+TEST(ParseIntegerTest, RejectsMalformedFields) {
+  int64_t value;
+  EXPECT_FALSE(parse("", &value));
+  EXPECT_FALSE(parse("-", &value));
+  EXPECT_FALSE(parse("+-1", &value));
+  EXPECT_FALSE(parse("12a", &value));
+  EXPECT_FALSE(parse(" 12", &value));
+  EXPECT_FALSE(parse("1.5", &value));
+
+  uint64_t unsignedValue;
+  EXPECT_FALSE(parseU("-1", &unsignedValue));
+  EXPECT_FALSE(parseU("", &unsignedValue));
+}
+
+TEST(ParseIntegerTest, RejectsOverflow) {
+  int64_t value;
+  EXPECT_TRUE(parse("9223372036854775807", &value));
+  EXPECT_EQ(value, INT64_MAX);
+  EXPECT_TRUE(parse("-9223372036854775808", &value));
+  EXPECT_EQ(value, INT64_MIN);
+  EXPECT_FALSE(parse("9223372036854775808", &value));
+  EXPECT_FALSE(parse("-9223372036854775809", &value));
+  EXPECT_FALSE(parse("100000000000000000000", &value));
+
+  uint64_t unsignedValue;
+  EXPECT_TRUE(parseU("18446744073709551615", &unsignedValue));
+  EXPECT_EQ(unsignedValue, UINT64_MAX);
+  EXPECT_FALSE(parseU("18446744073709551616", &unsignedValue));
+}
+
+TEST(ParseIntegerTest, RejectsValuesOutsideNarrowTypes) {
+  int32_t value;
+  EXPECT_TRUE(parse("-2147483648", &value));
+  EXPECT_EQ(value, INT32_MIN);
+  EXPECT_FALSE(parse("2147483648", &value));
+  EXPECT_FALSE(parse("-2147483649", &value));
+
+  uint16_t category;
+  EXPECT_TRUE(parseU("65535", &category));
+  EXPECT_EQ(category, 65535);
+  EXPECT_FALSE(parseU("65536", &category));
+
+  uint32_t unsignedValue;
+  EXPECT_FALSE(parseU("4294967296", &unsignedValue));
+}
+
+TEST(ParseDoubleTest, ParsesWholeFields) {
+  double value;
+  const char *field = "2.5e-1,";
+  EXPECT_TRUE(parseDouble(field, field + 6, &value));
+  EXPECT_DOUBLE_EQ(value, 0.25);
+  EXPECT_FALSE(parseDouble(field, field + 3, &value));
+  EXPECT_FALSE(parseDouble(field, field, &value));
+}
+
+TEST_F(ParsePlanTest, CompilesColumns) {
+  ParsePlan plan(csvDefinition);
+  EXPECT_EQ(plan.uniqueIdColumn, 0);
+  EXPECT_EQ(plan.startTimeColumn, -1);
+  EXPECT_EQ(plan.columns[1].kind, ParseKind::int32);
+  EXPECT_EQ(plan.columns[1].slot, 0);
+  EXPECT_EQ(plan.columns[2].kind, ParseKind::skip);
+  EXPECT_EQ(plan.columns[3].slot, 1);
+  // Nothing after the last used column is looked at
+  EXPECT_EQ(plan.numUsedColumns, 4);
+}
+
+TEST_F(ParsePlanTest, SkipsEmptyAndIgnoredFields) {
+  auto fields = split("7,,some notes,1.5,x");
+  ASSERT_EQ(fields.size(), 2);
+  EXPECT_EQ(fields[0].first, ParseKind::unique_id);
+  EXPECT_EQ(fields[0].second, "7");
+  EXPECT_EQ(fields[1].first, ParseKind::double_);
+  EXPECT_EQ(fields[1].second, "1.5");
+}
+
+TEST_F(ParsePlanTest, HandlesTrailingAndMissingFields) {
+  // The last field runs to the end of the line...
+  auto fields = split("7,30,,1.5");
+  ASSERT_EQ(fields.size(), 3);
+  EXPECT_EQ(fields[2].second, "1.5");
+
+  // ...an empty one at the end is skipped...
+  fields = split("7,30,,");
+  ASSERT_EQ(fields.size(), 2);
+  EXPECT_EQ(fields[1].second, "30");
+
+  // ...and short lines just stop early
+  fields = split("7");
+  ASSERT_EQ(fields.size(), 1);
+  EXPECT_EQ(fields[0].second, "7");
+}
+
+TEST_F(ParsePlanTest, ProjectsUnusedColumns) {
+  EXPECT_EQ(projectColumns(std::unordered_set<std::string>({"weight"}),
+        &csvDefinition), 1);
+  ParsePlan plan(csvDefinition);
+  EXPECT_EQ(plan.columns[0].kind, ParseKind::unique_id);
+  EXPECT_EQ(plan.columns[1].kind, ParseKind::skip);
+  EXPECT_EQ(plan.columns[3].kind, ParseKind::double_);
+  EXPECT_EQ(plan.columns[3].slot, 0);
+}
+
+}  // namespace
@@ -0,0 +1,114 @@
+/* Copyright 2020-2023 The Loimos Project Developers.
+ * See the top-level LICENSE file for details.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../loimos.decl.h"
+#include "../Extern.h"
+#include "../Types.h"
+#include "../VisitSchedule.h"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <vector>
+
+/** Tests interning of visit schedules. */
+
+namespace {
+
+// Adds a visit to each location offset in turn, an hour apart
+void addVisits(VisitSchedule *schedule, int day, Id person,
+    std::vector<uint32_t> locations) {
+  Time start = 0;
+  for (uint32_t location : locations) {
+    schedule->addVisit(day, person, firstLocationIdx + location, start, 600);
+    start += 3600;
+  }
+}
+
+std::vector<uint32_t> getLocations(const VisitSchedule &schedule, int day,
+    Id person) {
+  std::vector<uint32_t> locations;
+  for (const ScheduledVisit *visit = schedule.visitsBegin(day, person);
+      visit != schedule.visitsEnd(day, person); ++visit) {
+    locations.push_back(visit->locationOffset);
+  }
+  return locations;
+}
+
+TEST(VisitScheduleTest, SharesIdenticalSchedules) {
+  VisitSchedule schedule(4, 2);
+  addVisits(&schedule, 0, 0, {1, 2});
+  addVisits(&schedule, 0, 1, {1, 2});
+  addVisits(&schedule, 0, 3, {3});
+  schedule.finishDay(0);
+  addVisits(&schedule, 1, 0, {3});
+  addVisits(&schedule, 1, 1, {1, 2});
+  schedule.finishDay(1);
+
+  // The empty schedule, {1, 2}, and {3}
+  EXPECT_EQ(schedule.getNumSchedules(), 3);
+  EXPECT_EQ(schedule.getNumVisits(0), 5);
+  EXPECT_EQ(schedule.getNumVisits(1), 3);
+  EXPECT_EQ(schedule.visitsBegin(0, 0), schedule.visitsBegin(0, 1));
+  EXPECT_EQ(schedule.visitsBegin(0, 0), schedule.visitsBegin(1, 1));
+  EXPECT_EQ(schedule.visitsBegin(0, 3), schedule.visitsBegin(1, 0));
+  EXPECT_EQ(schedule.visitsBegin(0, 2), schedule.visitsEnd(0, 2));
+  EXPECT_EQ(getLocations(schedule, 0, 1), std::vector<uint32_t>({1, 2}));
+
+  const ScheduledVisit *visit = schedule.visitsBegin(0, 0) + 1;
+  EXPECT_EQ(visit->start, 3600);
+  EXPECT_EQ(visit->duration, 600);
+}
+
+TEST(VisitScheduleTest, ReusesReleasedSchedules) {
+  VisitSchedule schedule(1, 2);
+  addVisits(&schedule, 0, 0, {1, 2, 3, 4});
+  schedule.finishDay(0);
+  addVisits(&schedule, 1, 0, {5});
+  schedule.finishDay(1);
+  EXPECT_EQ(schedule.getNumSchedules(), 3);
+
+  // Too little is released to be worth compacting, so the old copy of the
+  // schedule is picked back up rather than added again
+  schedule.startDay(1);
+  EXPECT_EQ(schedule.getNumSchedules(), 3);
+  addVisits(&schedule, 1, 0, {5});
+  schedule.finishDay(1);
+  EXPECT_EQ(schedule.getNumSchedules(), 3);
+  EXPECT_EQ(getLocations(schedule, 1, 0), std::vector<uint32_t>({5}));
+}
+
+TEST(VisitScheduleTest, CompactsReloadedDays) {
+  // Load day 1 first, so its schedules get the lowest ids
+  VisitSchedule schedule(3, 2);
+  addVisits(&schedule, 1, 0, {4});
+  addVisits(&schedule, 1, 1, {5, 6, 7});
+  schedule.finishDay(1);
+  addVisits(&schedule, 0, 0, {1, 2});
+  addVisits(&schedule, 0, 2, {3});
+  schedule.finishDay(0);
+  EXPECT_EQ(schedule.getNumSchedules(), 5);
+
+  // Reloading day 1 leaves over half the visits unused, so they're dropped
+  // and day 0's schedules are renumbered
+  schedule.startDay(1);
+  EXPECT_EQ(schedule.getNumSchedules(), 3);
+  EXPECT_EQ(schedule.getNumVisits(1), 0);
+  EXPECT_EQ(schedule.visitsBegin(1, 1), schedule.visitsEnd(1, 1));
+  EXPECT_EQ(getLocations(schedule, 0, 0), std::vector<uint32_t>({1, 2}));
+  EXPECT_EQ(getLocations(schedule, 0, 1), std::vector<uint32_t>());
+  EXPECT_EQ(getLocations(schedule, 0, 2), std::vector<uint32_t>({3}));
+
+  // Schedules kept through compaction can still be found
+  addVisits(&schedule, 1, 0, {3});
+  addVisits(&schedule, 1, 2, {4});
+  schedule.finishDay(1);
+  EXPECT_EQ(schedule.getNumSchedules(), 4);
+  EXPECT_EQ(schedule.visitsBegin(1, 0), schedule.visitsBegin(0, 2));
+  EXPECT_EQ(getLocations(schedule, 1, 2), std::vector<uint32_t>({4}));
+  EXPECT_EQ(getLocations(schedule, 0, 0), std::vector<uint32_t>({1, 2}));
+}
+
+}  // namespace